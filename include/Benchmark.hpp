@@ -0,0 +1,51 @@
+#ifndef BENCHMARK_HPP
+#define BENCHMARK_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "BlockBuilder.hpp"
+#include "InputScript.hpp"
+
+// Memory in use at the end of a benchmark
+struct BenchmarkMemory {
+    // Chunk sections of the world
+    std::size_t worldBytes;
+    // Chunk meshes and block instances in GPU buffers
+    std::size_t meshBytes;
+};
+
+// Purpose:
+// Replays an input script at one scripted frame per loop and measures
+// every frame, then reports frame time percentiles, draw calls,
+// triangles and memory as JSON. Frame times cover the input, update,
+// render and swap of a frame up to glFinish, so GPU work is included.
+// Worker jobs started by a frame are finished before the next one, so
+// every run streams in and meshes the same chunks at the same frames and
+// runs can be compared. The wait for them is reported on its own, where
+// the cost of streaming, generating and meshing shows.
+class Benchmark {
+public:
+    // Replay script, writing the report to reportPath as well as stdout
+    // when it is not empty
+    Benchmark(const InputScript& script, const std::string& reportPath);
+    ~Benchmark();
+    // Push the input of frame, false once the script is over
+    bool BeginFrame(unsigned int frame);
+    // Record a frame that took seconds and drew stats
+    void EndFrame(double seconds, const RenderStats& stats);
+    // Record waiting seconds for the workers to finish a frame's jobs
+    void EndWorkerWait(double seconds);
+    // Print the report, renderer is the GL renderer string
+    void Report(const std::string& renderer, unsigned int threads, const BenchmarkMemory& memory);
+private:
+    InputScript m_script;
+    std::string m_reportPath;
+    std::vector<double> m_frameSeconds;
+    std::vector<double> m_workerWaitSeconds;
+    std::vector<unsigned int> m_drawCalls;
+    std::vector<unsigned int> m_triangles;
+};
+
+#endif
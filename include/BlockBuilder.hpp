@@ -3,7 +3,11 @@
 
 #include <glad/glad.h>
 
+#include <chrono>
+#include <deque>
+#include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "glm/vec3.hpp"
@@ -14,6 +18,9 @@
 #include "Texture.hpp"
 #include "Transform.hpp"
 #include "BlockData.hpp"
+#include "ChunkMesher.hpp"
+#include "JobSystem.hpp"
+#include "LockFreeQueue.hpp"
 
 struct FaceTexture {
     float leftU;
@@ -28,6 +35,67 @@ struct FaceTexture {
     }
 };
 
+// How the world is drawn
+enum RenderMode {
+    PerBlockRender, // One instanced draw of a cube per visible block
+    ChunkMeshRender // One draw call per chunk, hidden faces removed
+};
+
+// Chunk mesh builds started per frame, edited chunks first
+// Keeps the frame time flat while building or loading many chunks
+#define MESH_REQUESTS_PER_FRAME 16
+
+// Chunk culling and draw counters of the last frame
+struct RenderStats {
+    unsigned int chunksTested;
+    unsigned int chunksCulled;
+    unsigned int chunksDrawn;
+    unsigned int drawCalls;
+    unsigned int triangles;
+};
+
+// Geometry of a chunk built by a worker, waiting for upload
+struct MeshResult {
+    ChunkCoord coord;
+    // Request the mesh was built for
+    unsigned int ticket;
+    MeshData mesh;
+};
+
+// Meshing state of one chunk
+struct ChunkRenderState {
+    // Uploaded geometry, kept until a newer mesh arrives
+    std::unique_ptr<ChunkMesh> mesh;
+    // Generation of the last requested mesh, 0 if it needs a new one
+    unsigned int generation{0};
+    // Request whose result is accepted, results of older ones are dropped
+    unsigned int ticket{0};
+};
+
+// Totals of the meshes built since meshing last went idle
+struct MeshBatchStats {
+    unsigned int chunks{0};
+    unsigned int vertices{0};
+    unsigned int indices{0};
+    std::chrono::steady_clock::time_point start;
+};
+
+// Chunk in view whose mesh is out of date
+struct StaleChunk {
+    // Squared distance from the eye, nearest chunks are meshed first
+    float distance;
+    ChunkCoord coord;
+    const Chunk* chunk;
+    ChunkRenderState* state;
+};
+
+// Cube instances of one chunk in the instance buffer
+struct ChunkInstances {
+    ChunkCoord coord;
+    unsigned int first;
+    unsigned int count;
+};
+
 // Purpose:
 // An abstraction to create multiple BlockBuilders
 class BlockBuilder {
@@ -38,8 +106,9 @@ public:
     ~BlockBuilder();
     // Initialize buffers, texture, and shader
     void InitializeBlockData(std::string atlasFileName);
-    // Updates and transformations applied to BlockBuilder
-    void Update(BlockData& blockData, unsigned int screenWidth, unsigned int screenHeight);
+    // Offset of the geometry drawn next, in world coordinates
+    // View and projection come from the CameraUniforms buffer
+    void Update(int x, int y, int z);
     // How to draw the BlockBuilder
     void Render(BlocksArray& BlocksArray);
     // Returns an BlockBuilders transform
@@ -48,8 +117,37 @@ public:
     void ToggleLighting();
     // Reload shader while program is running for debugging
     void ReloadShaders();
+    // Cycle between culled chunk meshes, greedy chunk meshes and per block rendering
+    void ToggleRenderMode();
+    // Rebuild chunk meshes and block instances from the world
+    void InvalidateMeshes();
+    // Run chunk meshing on the workers of jobs instead of the render thread
+    void SetJobSystem(JobSystem* jobs);
+    // Chunk culling and draw counters of the last frame
+    const RenderStats& GetRenderStats() const;
+    // Bytes of the chunk meshes and block instances uploaded
+    std::size_t GetMeshMemory() const;
 private:
-    // Generate texture coordinates for the three face textures of a block and add to texture buffer
+    // Draw every visible block as an instance of the cube
+    void renderBlocks(BlocksArray& blocksArray);
+    // Draw one mesh per chunk, requesting meshes for chunks that have none
+    void renderChunkMeshes(BlocksArray& blocksArray);
+    // Mark the chunks edited since the last frame as out of date
+    // and release the meshes of unloaded chunks
+    void collectDirtyChunks(BlocksArray& blocksArray);
+    // Queue a mesh build of the chunk for the current generation
+    void requestMesh(const ChunkCoord& coord, const Chunk& chunk, ChunkRenderState& state);
+    // Upload the meshes workers finished since the last frame
+    void uploadFinishedMeshes();
+    // Returns true if the chunk is at least partly inside the view frustum
+    bool chunkInFrustum(const ChunkCoord& coord);
+    // Squared distance from the eye to the center of a chunk
+    float chunkDistance(const ChunkCoord& coord);
+    // Shader used by the current render mode
+    Shader& currentShader();
+    // Compile the per block and chunk mesh shaders
+    void loadShaders();
+    // Record the atlas tiles of the three face textures of a block
     void generateBlockTexture(BlockType blockType, int top, int side, int bottom);
     // Generate texture coordinates for given texture in atlas
     FaceTexture generateFaceTexture(int faceAtlasIndex);
@@ -57,20 +155,50 @@ private:
     std::vector<GLfloat> m_vertices;
     // BlockBuilder indices
     std::vector<GLuint> m_indices;
-    // For now we have one shader per BlockBuilder.
+    // Shader for drawing individual blocks
     Shader m_shader;
+    // Shader for drawing packed chunk meshes
+    Shader m_chunkShader;
     // For now we have one buffer per BlockBuilder.
     VertexBufferLayout m_vertexBufferLayout;
     // For now we have one texture per BlockBuilder
     Texture m_texture;
     // Store the BlockBuilders transformations
     Transform m_transform;
-    // Store the 'camera' projection
-    glm::mat4 m_projectionMatrix;
-    // Store texture coordinates of each block type
-    std::vector<GLfloat> m_blockTextures;
+    // Texture coordinates of the cube faces within their atlas tile
+    std::vector<GLfloat> m_faceTexCoords;
+    // Atlas tile of each face of each block type
+    std::vector<int> m_blockAtlasIndices;
     // Flag for enabling directional light in shader
     int lightingEnabled;
+    // Current way of drawing the world
+    RenderMode m_renderMode;
+    // Range of the instance buffer used by each chunk
+    std::vector<ChunkInstances> m_chunkInstances;
+    // Set when the world changed since the instance buffer was built
+    bool m_instancesDirty;
+    // Chunk culling counters of the last frame
+    RenderStats m_renderStats;
+    // Builds chunk geometry
+    ChunkMesher m_mesher;
+    // Meshes and meshing state of the chunks that have been in view
+    std::unordered_map<ChunkCoord, ChunkRenderState, ChunkCoordHash> m_chunkStates;
+    // Bumped whenever all chunk meshes are out of date
+    unsigned int m_meshGeneration;
+    // Id of the last mesh request
+    unsigned int m_meshTicket;
+    // Edited chunks waiting for a mesh build
+    std::deque<ChunkCoord> m_remeshQueue;
+    // Workers meshing chunks, nullptr to mesh on the render thread
+    JobSystem* m_jobs;
+    // Meshes finished by workers, drained by the render thread
+    LockFreeQueue<std::unique_ptr<MeshResult>> m_finishedMeshes;
+    // Requested meshes not drained from m_finishedMeshes yet
+    unsigned int m_pendingMeshes;
+    MeshBatchStats m_meshBatch;
+    // Report the next batch once it finishes, set for the meshing of the
+    // whole world at startup and after a render mode change
+    bool m_reportMeshBatch;
 };
 
 
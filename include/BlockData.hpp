@@ -1,12 +1,22 @@
 #ifndef BLOCKDATA_HPP
 #define BLOCKDATA_HPP
 
-#include "Transform.hpp"
+#include <cstdint>
+#include <cstddef>
 #include <iostream>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
-#define WIDTH 100
+// Default height of the world. The world is unbounded along x and z,
+// chunks there are loaded and unloaded around the camera.
 #define HEIGHT 256
-#define DEPTH 100
+
+// Blocks are stored in cubic sections of CHUNK_SIZE^3 cells
+#define CHUNK_SHIFT 4
+#define CHUNK_SIZE (1 << CHUNK_SHIFT)
+#define CHUNK_VOLUME (CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE)
 
 enum BlockType {
     Dirt,
@@ -22,88 +32,448 @@ enum BlockType {
     Empty
 };
 
+// Faces of a block, in the order of the cube vertex data and selection ids
+enum BlockFace {
+    FrontFace,  // +z
+    BackFace,   // -z
+    TopFace,    // +y
+    BottomFace, // -y
+    RightFace,  // +x
+    LeftFace,   // -x
+    NumFaces
+};
+
+// Offset to the neighboring block across each face
+static const int FACE_NORMALS[NumFaces][3] = {
+    {0, 0, 1}, {0, 0, -1}, {0, 1, 0}, {0, -1, 0}, {1, 0, 0}, {-1, 0, 0}
+};
+
 struct BlockData {
-    bool isVisible;
-    int blockType;
-    Transform m_transform; // Store transformations
+    // Bit per BlockFace, set if that face borders air or the world edge
+    // Zero for air and for blocks that are completely covered
+    uint8_t faceMask;
+    uint8_t blockType;
 };
 
-struct BlocksArray {
-    BlockData* blocks;
-
-    // Allocate memory for blocks and initialize structs
-    BlocksArray() {
-        blocks = new BlockData[WIDTH * HEIGHT * DEPTH];
-        for (int x = 0; x < WIDTH; x++) {
-            for (int y = 0; y < HEIGHT; y++) {
-                for (int z = 0; z < DEPTH; z++) {
-                    getBlock(x, y, z).isVisible = false;
-                    getBlock(x, y, z).blockType = Empty;
-                    getBlock(x, y, z).m_transform.Translate(x, y, z);
-                }
+// Position of a chunk in chunk units (block coordinate / CHUNK_SIZE)
+struct ChunkCoord {
+    int x;
+    int y;
+    int z;
+
+    bool operator==(const ChunkCoord& other) const {
+        return x == other.x && y == other.y && z == other.z;
+    }
+};
+
+struct ChunkCoordHash {
+    std::size_t operator()(const ChunkCoord& coord) const {
+        // Large primes spread neighboring chunks across buckets, multiplied
+        // unsigned so coordinates far from the origin wrap instead of overflowing
+        return ((std::size_t) (uint32_t) coord.x * 73856093u) ^
+            ((std::size_t) (uint32_t) coord.y * 19349663u) ^
+            ((std::size_t) (uint32_t) coord.z * 83492791u);
+    }
+};
+
+// Occupancy of one column of a chunk, bit z is set if the block at z is solid
+typedef uint16_t ChunkColumn;
+static_assert(sizeof(ChunkColumn) * 8 == CHUNK_SIZE, "a chunk column must fill one word");
+
+// Memory use of chunk sections, grouped by index width
+struct SectionStats {
+    std::size_t sections;
+    std::size_t bytes;
+    // Number of sections storing 0, 1, 2, 4 and 8 bits per block
+    std::size_t sectionsByBits[5];
+};
+
+// A CHUNK_SIZE^3 section of the world
+// Block types are palette compressed: the section keeps a palette of the
+// types it contains and one palette index per block, bit packed at the
+// smallest width that fits the palette (0, 1, 2, 4 or 8 bits). A section
+// of one type stores no indices at all. Writes only grow the width; a type
+// that disappears keeps its palette entry until compact is called. Face
+// masks and solid columns are only allocated once the section needs them.
+struct Chunk {
+    // Distinct block types of the section
+    std::vector<uint8_t> palette;
+    // Width of a palette index, 0 while the section holds one type
+    uint8_t bitsPerBlock;
+    // Palette indices, 64 / bitsPerBlock blocks per word
+    std::vector<uint64_t> indices;
+    // Face mask of every block, empty while all are zero
+    std::vector<uint8_t> faceMasks;
+    // Solid occupancy, one ChunkColumn per x, y laid out along z.
+    // Empty while the section holds one type, kept in sync by setBlockType.
+    std::vector<ChunkColumn> solid;
+
+    Chunk() {
+        palette.push_back(Empty);
+        bitsPerBlock = 0;
+    }
+
+    // Coordinates are local to the chunk (0 to CHUNK_SIZE - 1)
+    static int blockIndex(int x, int y, int z) {
+        return z + y*CHUNK_SIZE + x*CHUNK_SIZE*CHUNK_SIZE;
+    }
+
+    uint8_t getBlockType(int x, int y, int z) const {
+        if (bitsPerBlock == 0) {
+            return palette[0];
+        }
+        // Widths divide 64, so an index never spans two words
+        unsigned int bit = blockIndex(x, y, z) * bitsPerBlock;
+        return palette[(indices[bit >> 6] >> (bit & 63)) & ((1u << bitsPerBlock) - 1)];
+    }
+
+    uint8_t getFaceMask(int x, int y, int z) const {
+        return faceMasks.empty() ? 0 : faceMasks[blockIndex(x, y, z)];
+    }
+
+    BlockData getBlock(int x, int y, int z) const {
+        return (BlockData) {getFaceMask(x, y, z), getBlockType(x, y, z)};
+    }
+
+    void setFaceMask(int x, int y, int z, uint8_t faceMask) {
+        if (faceMasks.empty()) {
+            if (faceMask == 0) {
+                return;
+            }
+            faceMasks.assign(CHUNK_VOLUME, 0);
+        }
+        faceMasks[blockIndex(x, y, z)] = faceMask;
+    }
+
+    // Face masks are left to the caller, except that air has none
+    void setBlockType(int x, int y, int z, uint8_t blockType) {
+        unsigned int paletteIndex = 0;
+        while (paletteIndex < palette.size() && palette[paletteIndex] != blockType) {
+            paletteIndex++;
+        }
+        if (paletteIndex == palette.size()) {
+            palette.push_back(blockType);
+            if (palette.size() > (1u << bitsPerBlock)) {
+                widenIndices();
+            }
+        }
+        if (bitsPerBlock > 0) {
+            unsigned int bit = blockIndex(x, y, z) * bitsPerBlock;
+            uint64_t mask = (uint64_t) ((1u << bitsPerBlock) - 1) << (bit & 63);
+            indices[bit >> 6] = (indices[bit >> 6] & ~mask) | ((uint64_t) paletteIndex << (bit & 63));
+            if (blockType == Empty) {
+                solid[x*CHUNK_SIZE + y] &= (ChunkColumn) ~(1u << z);
+            }
+            else {
+                solid[x*CHUNK_SIZE + y] |= (ChunkColumn) (1u << z);
+            }
+        }
+        if (blockType == Empty) {
+            setFaceMask(x, y, z, 0);
+        }
+    }
+
+    // Double the index width (0 goes to 1) and repack every block
+    void widenIndices() {
+        uint8_t newBits = bitsPerBlock == 0 ? 1 : bitsPerBlock * 2;
+        std::vector<uint64_t> newIndices(CHUNK_VOLUME * newBits / 64, 0);
+        if (bitsPerBlock > 0) {
+            for (int i = 0; i < CHUNK_VOLUME; i++) {
+                unsigned int bit = i * bitsPerBlock;
+                uint64_t paletteIndex = (indices[bit >> 6] >> (bit & 63)) & ((1u << bitsPerBlock) - 1);
+                unsigned int newBit = i * newBits;
+                newIndices[newBit >> 6] |= paletteIndex << (newBit & 63);
+            }
+        }
+        else {
+            // Every block was palette entry 0, whose occupancy is uniform
+            solid.assign(CHUNK_SIZE * CHUNK_SIZE, palette[0] != Empty ? (ChunkColumn) ~0 : 0);
+        }
+        indices.swap(newIndices);
+        bitsPerBlock = newBits;
+    }
+
+    // Drop the palette entries no block uses and repack the indices at
+    // the smallest width that fits. A section left with one type becomes
+    // uniform and frees its indices and solid columns.
+    void compact() {
+        if (bitsPerBlock == 0) {
+            return;
+        }
+        unsigned int indexMask = (1u << bitsPerBlock) - 1;
+        bool used[256] = {false};
+        for (int i = 0; i < CHUNK_VOLUME; i++) {
+            unsigned int bit = i * bitsPerBlock;
+            used[(indices[bit >> 6] >> (bit & 63)) & indexMask] = true;
+        }
+        // New index of each used palette entry
+        uint8_t remap[256];
+        std::vector<uint8_t> newPalette;
+        for (unsigned int i = 0; i < palette.size(); i++) {
+            if (used[i]) {
+                remap[i] = newPalette.size();
+                newPalette.push_back(palette[i]);
+            }
+        }
+        uint8_t newBits = 0;
+        while ((1u << newBits) < newPalette.size()) {
+            newBits = newBits == 0 ? 1 : newBits * 2;
+        }
+        if (newBits == bitsPerBlock && newPalette.size() == palette.size()) {
+            return;
+        }
+        std::vector<uint64_t> newIndices(CHUNK_VOLUME * newBits / 64, 0);
+        if (newBits > 0) {
+            for (int i = 0; i < CHUNK_VOLUME; i++) {
+                unsigned int bit = i * bitsPerBlock;
+                uint64_t paletteIndex = remap[(indices[bit >> 6] >> (bit & 63)) & indexMask];
+                unsigned int newBit = i * newBits;
+                newIndices[newBit >> 6] |= paletteIndex << (newBit & 63);
+            }
+        }
+        else {
+            std::vector<ChunkColumn>().swap(solid);
+        }
+        palette.swap(newPalette);
+        indices.swap(newIndices);
+        bitsPerBlock = newBits;
+    }
+
+    // Recompute the solid columns from the palette indices, for a
+    // section whose indices were filled in directly
+    void rebuildSolid() {
+        if (bitsPerBlock == 0) {
+            std::vector<ChunkColumn>().swap(solid);
+            return;
+        }
+        solid.assign(CHUNK_SIZE * CHUNK_SIZE, 0);
+        unsigned int indexMask = (1u << bitsPerBlock) - 1;
+        for (int i = 0; i < CHUNK_VOLUME; i++) {
+            unsigned int bit = i * bitsPerBlock;
+            if (palette[(indices[bit >> 6] >> (bit & 63)) & indexMask] != Empty) {
+                // blockIndex puts z in the low bits and x, y above it
+                solid[i >> CHUNK_SHIFT] |= (ChunkColumn) (1u << (i & (CHUNK_SIZE - 1)));
             }
         }
     }
 
-    ~BlocksArray() {
-        delete[] blocks;
+    // Occupancy of the column at local x, y
+    ChunkColumn solidColumn(int x, int y) const {
+        if (solid.empty()) {
+            return palette[0] != Empty ? (ChunkColumn) ~0 : 0;
+        }
+        return solid[x*CHUNK_SIZE + y];
+    }
+
+    bool isSolid(int x, int y, int z) const {
+        return (solidColumn(x, y) >> z) & 1;
+    }
+
+    // Bytes held by the section
+    std::size_t memoryUsage() const {
+        return sizeof(Chunk) + palette.capacity() + indices.capacity() * sizeof(uint64_t) +
+            faceMasks.capacity() + solid.capacity() * sizeof(ChunkColumn);
+    }
+};
+
+// World store made of chunks keyed by chunk coordinate.
+// Chunks are only allocated once a block inside them is written,
+// so empty sky costs nothing.
+struct BlocksArray {
+    std::unordered_map<ChunkCoord, std::unique_ptr<Chunk>, ChunkCoordHash> chunks;
+    // Chunks whose blocks changed since the renderer last collected them.
+    // A set, so any number of edits to one chunk leave a single entry.
+    std::unordered_set<ChunkCoord, ChunkCoordHash> dirtyChunks;
+    // Chunks unloaded since the renderer last collected them
+    std::unordered_set<ChunkCoord, ChunkCoordHash> removedChunks;
+    // Chunk columns edited since they were last saved, keyed with y = 0
+    std::unordered_set<ChunkCoord, ChunkCoordHash> unsavedColumns;
+    // World height in blocks, x and z are unbounded
+    int height;
+
+    BlocksArray(int h = HEIGHT) : height(h) {}
+
+    // Chunk containing the block, floor division so negative coordinates work
+    static ChunkCoord toChunkCoord(int x, int y, int z) {
+        return (ChunkCoord) {x >> CHUNK_SHIFT, y >> CHUNK_SHIFT, z >> CHUNK_SHIFT};
+    }
+
+    // Return true if the block coordinates are within the world bounds
+    // Only y is bounded, x and z are unbounded.
+    bool isValidBlock(int /*x*/, int y, int /*z*/) const {
+        return y >= 0 && y < height;
+    }
+
+    // Returns the chunk at the given chunk coordinate or nullptr if it was never written
+    Chunk* findChunk(const ChunkCoord& coord) const {
+        auto it = chunks.find(coord);
+        return it == chunks.end() ? nullptr : it->second.get();
+    }
+
+    // Returns the chunk containing the block, allocating it if needed
+    Chunk& getChunk(int x, int y, int z) {
+        std::unique_ptr<Chunk>& chunk = chunks[toChunkCoord(x, y, z)];
+        if (!chunk) {
+            chunk.reset(new Chunk());
+        }
+        return *chunk;
+    }
+
+    // Returns a copy of the block, air if its chunk does not exist
+    // Use setBlockType and updateFaceMask to change blocks
+    BlockData getBlock(int x, int y, int z) const {
+        Chunk* chunk = findChunk(toChunkCoord(x, y, z));
+        if (chunk == nullptr) {
+            return (BlockData) {0, Empty};
+        }
+        return chunk->getBlock(x & (CHUNK_SIZE - 1), y & (CHUNK_SIZE - 1), z & (CHUNK_SIZE - 1));
+    }
+
+    // Change the type of a block, allocating its chunk if needed
+    void setBlockType(int x, int y, int z, uint8_t blockType) {
+        dirtyChunks.insert(toChunkCoord(x, y, z));
+        unsavedColumns.insert((ChunkCoord) {x >> CHUNK_SHIFT, 0, z >> CHUNK_SHIFT});
+        getChunk(x, y, z).setBlockType(x & (CHUNK_SIZE - 1), y & (CHUNK_SIZE - 1), z & (CHUNK_SIZE - 1), blockType);
     }
 
-    // Return true if the block coordinates are within the WIDTH, HEIGHT, and DEPTH bounds
-    bool isValidBlock(int x, int y, int z) {
-        return x >= 0 && x < WIDTH && y >= 0 && y < HEIGHT && z >= 0 && z < DEPTH;
+    bool isSolidBlock(int x, int y, int z) const {
+        if (!isValidBlock(x, y, z)) {
+            return false;
+        }
+        const Chunk* chunk = findChunk(toChunkCoord(x, y, z));
+        return chunk != nullptr && chunk->isSolid(x & (CHUNK_SIZE - 1), y & (CHUNK_SIZE - 1), z & (CHUNK_SIZE - 1));
     }
 
-    BlockData& getBlock(int x, int y, int z) {
-        return blocks[z + y*DEPTH + x*HEIGHT*DEPTH];
+    // Occupancy of the column at world x, y inside chunk layer chunkZ,
+    // zero where no chunk is loaded. Only blocks inside the world are
+    // ever written, so columns above and below it are always empty.
+    ChunkColumn solidColumn(int x, int y, int chunkZ) const {
+        const Chunk* chunk = findChunk((ChunkCoord) {x >> CHUNK_SHIFT, y >> CHUNK_SHIFT, chunkZ});
+        return chunk == nullptr ? 0 : chunk->solidColumn(x & (CHUNK_SIZE - 1), y & (CHUNK_SIZE - 1));
     }
 
-    bool isSolidBlock(int x, int y, int z) {
-        return isValidBlock(x, y, z) && getBlock(x, y, z).blockType != Empty;
+    // Occupancy of the six neighbors of every block in the column at local
+    // x, y of a chunk, in BlockFace order: bit z of neighbors[face] is set if
+    // the block across that face of block z is solid. The z neighbors are the
+    // column itself shifted by one, carrying in the edge of the next chunk.
+    void neighborColumns(const ChunkCoord& coord, const Chunk& chunk, int x, int y, ChunkColumn neighbors[NumFaces]) const {
+        int worldX = coord.x*CHUNK_SIZE + x;
+        int worldY = coord.y*CHUNK_SIZE + y;
+        ChunkColumn column = chunk.solidColumn(x, y);
+        neighbors[FrontFace] = (ChunkColumn) ((column >> 1) | (solidColumn(worldX, worldY, coord.z + 1) << (CHUNK_SIZE - 1)));
+        neighbors[BackFace] = (ChunkColumn) ((column << 1) | (solidColumn(worldX, worldY, coord.z - 1) >> (CHUNK_SIZE - 1)));
+        neighbors[TopFace] = y < CHUNK_SIZE - 1 ? chunk.solidColumn(x, y + 1) : solidColumn(worldX, worldY + 1, coord.z);
+        neighbors[BottomFace] = y > 0 ? chunk.solidColumn(x, y - 1) : solidColumn(worldX, worldY - 1, coord.z);
+        neighbors[RightFace] = x < CHUNK_SIZE - 1 ? chunk.solidColumn(x + 1, y) : solidColumn(worldX + 1, worldY, coord.z);
+        neighbors[LeftFace] = x > 0 ? chunk.solidColumn(x - 1, y) : solidColumn(worldX - 1, worldY, coord.z);
     }
 
-    bool isSurrounded(int x, int y, int z) {
-        return isSolidBlock(x - 1, y, z) && isSolidBlock(x + 1, y, z) &&
-                isSolidBlock(x, y - 1, z) && isSolidBlock(x, y + 1, z) &&
-                isSolidBlock(x, y, z - 1) && isSolidBlock(x, y, z + 1);
+    // True if any face of the block is exposed
+    bool isVisibleBlock(int x, int y, int z) const {
+        if (!isValidBlock(x, y, z)) {
+            return false;
+        }
+        return getBlock(x, y, z).faceMask != 0;
     }
 
-    void hideBlockIfSurrounded(int x, int y, int z) {
-        if (isValidBlock(x, y, z) && isSurrounded(x, y, z)) {
-            getBlock(x, y, z).isVisible = false;
+    // Recompute the exposed faces of one block from its neighbors
+    void updateFaceMask(int x, int y, int z) {
+        if (!isSolidBlock(x, y, z)) {
+            // Air has no faces, and blocks outside the world are never stored
+            return;
+        }
+        uint8_t faceMask = 0;
+        for (int face = 0; face < NumFaces; face++) {
+            if (!isSolidBlock(x + FACE_NORMALS[face][0], y + FACE_NORMALS[face][1], z + FACE_NORMALS[face][2])) {
+                faceMask |= 1 << face;
+            }
+        }
+        Chunk& chunk = getChunk(x, y, z);
+        int localX = x & (CHUNK_SIZE - 1);
+        int localY = y & (CHUNK_SIZE - 1);
+        int localZ = z & (CHUNK_SIZE - 1);
+        if (chunk.getFaceMask(localX, localY, localZ) != faceMask) {
+            chunk.setFaceMask(localX, localY, localZ, faceMask);
+            // Neighbors across a chunk border live in another chunk
+            dirtyChunks.insert(toChunkCoord(x, y, z));
         }
     }
 
-    void revealSurroundingBlocks(int x, int y, int z) {
-        makeVisible(x - 1, y, z);
-        makeVisible(x + 1, y, z);
-        makeVisible(x, y - 1, z);
-        makeVisible(x, y + 1, z);
-        makeVisible(x, y, z - 1);
-        makeVisible(x, y, z + 1);
+    // Update the face masks an edit of the block at x, y, z can change:
+    // the block itself and its six neighbors
+    void updateFaceMasksAround(int x, int y, int z) {
+        updateFaceMask(x, y, z);
+        for (int face = 0; face < NumFaces; face++) {
+            updateFaceMask(x + FACE_NORMALS[face][0], y + FACE_NORMALS[face][1], z + FACE_NORMALS[face][2]);
+        }
     }
 
-    void hideSurroundingBlocks(int x, int y, int z) {
-        hideBlockIfSurrounded(x - 1, y, z);
-        hideBlockIfSurrounded(x + 1, y, z);
-        hideBlockIfSurrounded(x, y - 1, z);
-        hideBlockIfSurrounded(x, y + 1, z);
-        hideBlockIfSurrounded(x, y, z - 1);
-        hideBlockIfSurrounded(x, y, z + 1);
+    // Compute the exposed faces of the blocks of one chunk
+    // Returns true if any face mask changed. The masks of a chunk left
+    // without exposed faces are released.
+    bool computeFaceMasks(const ChunkCoord& coord, Chunk& chunk) {
+        bool changed = false;
+        bool exposed = false;
+        for (int x = 0; x < CHUNK_SIZE; x++) {
+            for (int y = 0; y < CHUNK_SIZE; y++) {
+                ChunkColumn column = chunk.solidColumn(x, y);
+                if (column == 0) {
+                    continue;
+                }
+                ChunkColumn neighbors[NumFaces];
+                neighborColumns(coord, chunk, x, y, neighbors);
+                for (int z = 0; z < CHUNK_SIZE; z++) {
+                    if (((column >> z) & 1) == 0) {
+                        continue;
+                    }
+                    uint8_t faceMask = 0;
+                    for (int face = 0; face < NumFaces; face++) {
+                        if (((neighbors[face] >> z) & 1) == 0) {
+                            faceMask |= 1 << face;
+                        }
+                    }
+                    if (chunk.getFaceMask(x, y, z) != faceMask) {
+                        chunk.setFaceMask(x, y, z, faceMask);
+                        changed = true;
+                    }
+                    exposed = exposed || faceMask != 0;
+                }
+            }
+        }
+        if (!exposed) {
+            std::vector<uint8_t>().swap(chunk.faceMasks);
+        }
+        return changed;
     }
 
-    // TODO: use isCoveredBlock
-    void makeVisible(int x, int y, int z) {
-        if (isValidBlock(x, y, z) && getBlock(x, y, z).blockType != Empty) {
-            getBlock(x, y, z).isVisible = true;
+    // Drop a chunk from the world, the renderer releases its mesh
+    void removeChunk(const ChunkCoord& coord) {
+        if (chunks.erase(coord) > 0) {
+            dirtyChunks.erase(coord);
+            removedChunks.insert(coord);
         }
     }
 
-    void makeInvisible(int x, int y, int z) {
-        if (isValidBlock(x, y, z) && getBlock(x, y, z).blockType != Empty) {
-            getBlock(x, y, z).isVisible = false;
+    // Bytes held by allocated chunks
+    std::size_t memoryUsage() const {
+        return sectionStats().bytes;
+    }
+
+    // Memory use of all sections, grouped by index width
+    SectionStats sectionStats() const {
+        SectionStats stats = {0, 0, {0, 0, 0, 0, 0}};
+        for (auto& entry : chunks) {
+            const Chunk& chunk = *entry.second;
+            stats.sections++;
+            stats.bytes += chunk.memoryUsage() + sizeof(ChunkCoord) + sizeof(void*);
+            int widthIndex = 0;
+            for (int bits = chunk.bitsPerBlock; bits > 0; bits >>= 1) {
+                widthIndex++;
+            }
+            stats.sectionsByBits[widthIndex]++;
         }
+        return stats;
     }
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -20,6 +20,15 @@ public:
     // Return a 'view' matrix with our
     // camera transformation applied.
     glm::mat4 GetWorldToViewmatrix() const;
+    // Set the 'projection' matrix used by every frame
+    void SetProjection(float fieldOfView, float aspectRatio, float nearPlane, float farPlane);
+    // Return the 'projection' matrix
+    const glm::mat4& GetProjectionMatrix() const;
+    // Recompute the frustum planes from the current view and projection
+    // Called once per frame, before anything is culled
+    void UpdateFrustum();
+    // Returns false if the axis aligned box is completely outside the frustum
+    bool IsBoxInFrustum(const glm::vec3& boxMin, const glm::vec3& boxMax) const;
     // Move the camera around
     void MouseLook(int mouseX, int mouseY);
     void MoveForward(float speed, BlocksArray& BlocksArray);
@@ -33,6 +42,8 @@ public:
     float GetEyeXPosition();
     float GetEyeYPosition();
     float GetEyeZPosition();
+    // Place the camera without checking for collisions
+    void SetEyePosition(const glm::vec3& position);
 	// Returns the 'view' position
     float GetViewXDirection();
     float GetViewYDirection();
@@ -59,6 +70,11 @@ private:
     float yaw;
     float pitch;
     bool collisionEnabled;
+    // Perspective projection of the camera
+    glm::mat4 m_projectionMatrix;
+    // Left, right, bottom, top, near and far plane of the view frustum
+    // xyz is the inward facing normal and w the distance
+    glm::vec4 m_frustumPlanes[6];
 };
 
 #endif
\ No newline at end of file
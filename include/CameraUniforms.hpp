@@ -0,0 +1,30 @@
+#ifndef CAMERAUNIFORMS_HPP
+#define CAMERAUNIFORMS_HPP
+
+#include <glad/glad.h>
+
+#include "Camera.hpp"
+
+// Uniform buffer binding point of the CameraUniforms block
+#define CAMERA_UNIFORM_BINDING 0
+
+// Purpose:
+// Uniform buffer holding the view and projection of the current frame.
+// It is filled once per frame and shared by every shader declaring the
+// CameraUniforms block, so draws only set their own uniforms.
+class CameraUniforms {
+public:
+    // CameraUniforms Constructor
+    CameraUniforms();
+    // CameraUniforms destructor
+    ~CameraUniforms();
+    // Allocate the buffer and attach it to CAMERA_UNIFORM_BINDING
+    void Create();
+    // Copy the camera matrices into the buffer
+    void Update(const Camera& camera);
+private:
+    // Uniform buffer ID
+    GLuint m_buffer{0};
+};
+
+#endif
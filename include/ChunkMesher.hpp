@@ -0,0 +1,72 @@
+#ifndef CHUNKMESHER_HPP
+#define CHUNKMESHER_HPP
+
+#include <glad/glad.h>
+
+#include <vector>
+
+#include "BlockData.hpp"
+#include "VertexBufferLayout.hpp"
+
+// 32 bit words per chunk mesh vertex
+#define CHUNK_VERTEX_WORDS 2
+
+// CPU-side geometry of one chunk
+// Each vertex is packed into two words, unpacked by chunk_vert.glsl:
+//   word 0: bits 0-14  corner x,y,z relative to the chunk origin (5 bits each, 0-16)
+//           bits 15-17 face (BlockFace), which gives the normal
+//           bits 18-27 s,t measured in blocks (5 bits each, 0-16) so a
+//                      merged face repeats its atlas tile
+//   word 1: bits 0-7   atlas tile index
+struct MeshData {
+    std::vector<GLuint> vertices;
+    std::vector<GLuint> indices;
+};
+
+// GPU buffers of one chunk
+struct ChunkMesh {
+    VertexBufferLayout layout;
+    unsigned int indexCount{0};
+    unsigned int vertexCount{0};
+
+    // Replace the buffer contents with new geometry
+    void Upload(const MeshData& mesh);
+};
+
+// How faces are turned into quads
+enum MeshingMode {
+    CulledMeshing, // One quad per exposed block face
+    GreedyMeshing  // Coplanar faces of the same block type merged into larger quads
+};
+
+// Purpose:
+// Turns the blocks of a chunk into a single mesh containing
+// only the faces that border air or the edge of the world,
+// as recorded in the face mask of each block
+class ChunkMesher {
+public:
+    ChunkMesher();
+    ~ChunkMesher();
+    // Copy the cube face vertices (x,y,z,nx,ny,nz per vertex, 4 per face)
+    // and the atlas tile of each face of each block type (6 per block type)
+    void Initialize(const std::vector<GLfloat>& cubeVertices, const std::vector<int>& blockAtlasIndices);
+    // Build the mesh of a chunk, safe to call from several threads at once
+    void Mesh(const Chunk& chunk, MeshingMode mode, MeshData& out) const;
+    // Select how faces are turned into quads by default
+    void SetMode(MeshingMode mode);
+    MeshingMode GetMode() const;
+private:
+    // Emit one quad per exposed face
+    void meshCulled(const Chunk& chunk, MeshData& out) const;
+    // Merge exposed faces slice by slice into the largest rectangles possible
+    void meshGreedy(const Chunk& chunk, MeshData& out) const;
+    // Append a quad covering size[] blocks starting at local block base[]
+    void addQuad(MeshData& out, int face, int blockType, const int base[3], const int size[3]) const;
+    std::vector<GLfloat> m_cubeVertices;
+    std::vector<int> m_blockAtlasIndices;
+    // Direction in which s and t grow across each face
+    int m_faceAxes[NumFaces][2][3];
+    MeshingMode m_mode;
+};
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef COMPRESSION_HPP
+#define COMPRESSION_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// LZ4 block format, without the frame around it.
+// A block is a run of sequences, each a token byte (literal length in
+// the high nibble, match length - 4 in the low one, 15 meaning more
+// length bytes follow), the literals, and a 16 bit little endian offset
+// back into the output followed by the extra match length bytes. The
+// last sequence has literals only. Blocks made by the reference LZ4
+// library decompress here and the other way around.
+
+// Bytes hashed to find matches, and the shortest match encoded
+#define LZ4_MIN_MATCH 4
+// The last match starts at least this many bytes before the end
+#define LZ4_MATCH_FIND_LIMIT 12
+// and the last LZ4_LAST_LITERALS bytes are always literals
+#define LZ4_LAST_LITERALS 5
+#define LZ4_MAX_OFFSET 65535
+// Entries of the match finder hash table
+#define LZ4_HASH_BITS 12
+
+// Replace out with the compressed form of the size bytes at src
+void CompressLZ4(const uint8_t* src, std::size_t size, std::vector<uint8_t>& out);
+// Decompress a block into exactly dstSize bytes at dst
+// Returns false if the block is corrupt or does not decompress to dstSize bytes.
+bool DecompressLZ4(const uint8_t* src, std::size_t size, uint8_t* dst, std::size_t dstSize);
+
+// zlib stream (RFC 1950) holding one deflate block (RFC 1951) with the
+// fixed Huffman codes, as PNG images store their pixels. Slower to
+// decode than LZ4 but readable by any zlib.
+
+// Longest match and farthest distance deflate can encode
+#define DEFLATE_MAX_MATCH 258
+#define DEFLATE_MAX_DISTANCE 32768
+// Entries of the match finder hash table
+#define DEFLATE_HASH_BITS 15
+
+// Replace out with the zlib stream of the size bytes at src
+void CompressZlib(const uint8_t* src, std::size_t size, std::vector<uint8_t>& out);
+
+#endif
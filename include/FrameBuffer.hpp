@@ -0,0 +1,37 @@
+#ifndef FRAMEBUFFER_HPP
+#define FRAMEBUFFER_HPP
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <vector>
+
+// Purpose:
+// Offscreen color and depth buffers to render into instead of a
+// window. The default framebuffer of a hidden window may never be
+// drawn, since pixels no window shows fail the ownership test, so
+// headless frames are drawn and read back here.
+class FrameBuffer {
+public:
+    // FrameBuffer Constructor
+    FrameBuffer();
+    // FrameBuffer destructor
+    ~FrameBuffer();
+    // Allocate width x height RGBA color and 24 bit depth buffers
+    // Returns false if the driver cannot render to them.
+    bool Create(int width, int height);
+    // Draw into the buffers
+    void Bind();
+    // Draw into the window again
+    void Unbind();
+    // Read the color buffer as 8 bit RGB, rows top first
+    void ReadPixels(std::vector<uint8_t>& pixels);
+private:
+    GLuint m_framebuffer{0};
+    GLuint m_color{0};
+    GLuint m_depth{0};
+    int m_width{0};
+    int m_height{0};
+};
+
+#endif
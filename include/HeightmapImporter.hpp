@@ -0,0 +1,56 @@
+#ifndef HEIGHTMAPIMPORTER_HPP
+#define HEIGHTMAPIMPORTER_HPP
+
+#include <functional>
+#include <vector>
+
+#include "Image.hpp"
+#include "JobSystem.hpp"
+#include "TerrainGenerator.hpp"
+
+// Block columns along each side of an import tile, a multiple of CHUNK_SIZE
+#define IMPORT_TILE_SIZE 256
+// Chunk columns an import may keep in memory when it is not saved to
+// region files, at roughly 15 KB each
+#define IMPORT_MAX_RESIDENT_COLUMNS 65536
+
+// Totals of the last import
+struct ImportStats {
+    unsigned int tiles;
+    unsigned int columns;
+    // Most tiles held in memory at once
+    unsigned int tilesInFlight;
+    double seconds;
+};
+
+// Purpose:
+// Turns a heightmap into chunk columns one tile at a time, for maps far
+// larger than the world kept in memory. The image covers world x from 0
+// to its width and z from 0 to its height. Tiles are read and filled on
+// the worker threads a wave at a time, one tile per thread, and every
+// wave is handed to the sink before the next one starts. Memory is
+// bounded by the tiles of one wave, not by the size of the image, as
+// long as the sink does not keep the chunks; a memory mapped image is
+// paged in a tile at a time.
+class HeightmapImporter {
+public:
+    // Called on the importing thread with the chunk columns of every
+    // wave, which may take their chunks
+    typedef std::function<void(std::vector<GeneratedColumn>& columns)> WaveSink;
+    // image must stay loaded while importing
+    HeightmapImporter(const Image& image, int worldHeight);
+    ~HeightmapImporter();
+    // Fill tiles on the workers of jobs instead of the calling thread
+    void SetJobSystem(JobSystem* jobs);
+    // Fill every tile of the image and pass its chunk columns to sink
+    const ImportStats& Import(const WaveSink& sink);
+private:
+    // Read the heights of the tile at tileX, tileZ, counted in tiles
+    void readTile(int tileX, int tileZ, HeightTile& tile) const;
+    const Image& m_image;
+    int m_worldHeight;
+    JobSystem* m_jobs;
+    ImportStats m_stats;
+};
+
+#endif
@@ -1,7 +1,9 @@
 /** @file Image.hpp
- *  @brief Load a PPM image for processing
+ *  @brief Load a PPM, PGM or PNG image for processing, and write PNGs
  *
- *  More...
+ *  Binary PNM files are memory mapped and read in place, ASCII PNM files
+ *  are read in one bulk read and parsed from memory, and anything else
+ *  is decoded by stb_image. Samples may be 8 or 16 bits.
  *
  *  @author Mike
  *  @bug No known bugs.
@@ -9,7 +11,10 @@
 #ifndef IMAGE_HPP
 #define IMAGE_HPP
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
+#include <vector>
 
 class Image {
 public:
@@ -19,46 +24,99 @@ public:
     ~Image();
     // Loads a PPM from memory.
     void LoadPPM(bool flip);
+    // Loads a P2/P3/P5/P6 PNM, or any format stb_image reads (PNG, ...)
+    // flip - reverse the order of the pixels, turning the image upside
+    //        down and mirroring it, by remapping indices instead of moving data
+    // Returns false if the file could not be read.
+    bool Load(bool flip);
     // Return the width
-    inline int GetWidth(){
+    inline int GetWidth() const {
         return m_width;
     }
     // Return the height
-    inline int GetHeight(){
+    inline int GetHeight() const {
         return m_height;
     }
     // Bytes per pixel
-    inline int GetBPP(){
+    inline int GetBPP() const {
         return m_BPP;
     }
+    // Largest sample value, 255 for 8 bit and up to 65535 for 16 bit images
+    inline int GetMaxValue() const {
+        return m_maxValue;
+    }
     // Set a pixel a particular color in our data
     void SetPixel(int x, int y, uint8_t r, uint8_t g, uint8_t b);
     // Display the pixels
     void PrintPixels();
     // Retrieve raw array of pixel data
+    // Samples are in file order, 16 bit samples are big endian for PNM.
     uint8_t* GetPixelDataPtr();
-    // Returns the red component of a pixel
+    // Returns channel 0-2 of a pixel at full precision, 0 to GetMaxValue()
+    // Gray images return their gray value for every channel.
+    inline unsigned int GetSample(int x, int y, int channel) const {
+        const uint8_t* sample = m_pixelData + sampleOffset(x, y, channel);
+        if (m_bytesPerSample == 1) {
+            return sample[0];
+        }
+        return m_bigEndian ? (sample[0] << 8) | sample[1] : (sample[1] << 8) | sample[0];
+    }
+    // Returns the red component of a pixel, scaled to 0-255
     inline unsigned int GetPixelR(int x, int y){
-        return m_pixelData[(x*3)+m_height*(y*3)];
+        return GetSample(x, y, 0) * 255 / m_maxValue;
     }
-    // Returns the green component of a pixel
+    // Returns the green component of a pixel, scaled to 0-255
     inline unsigned int GetPixelG(int x, int y){
-        return m_pixelData[(x*3)+m_height*(y*3)+1];
+        return GetSample(x, y, 1) * 255 / m_maxValue;
     }
-    // Returns the blue component of a pixel
+    // Returns the blue component of a pixel, scaled to 0-255
     inline unsigned int GetPixelB(int x, int y){
-        return m_pixelData[(x*3)+m_height*(y*3)+2];
+        return GetSample(x, y, 2) * 255 / m_maxValue;
     }
 private:
+    // Byte offset of a sample, applying the flip
+    inline std::size_t sampleOffset(int x, int y, int channel) const {
+        std::size_t pixel = (std::size_t) y * m_width + x;
+        if (m_flip) {
+            pixel = (std::size_t) m_width * m_height - 1 - pixel;
+        }
+        if (m_channels < 3) {
+            channel = 0;
+        }
+        return (pixel * m_channels + channel) * m_bytesPerSample;
+    }
+    // Parse a PNM file held in memory, pointing the pixel data into it
+    // for binary files and into m_buffer for ASCII files
+    bool parsePNM(const uint8_t* data, std::size_t size);
+    // Decode the file with stb_image
+    bool loadWithStb();
+    // Release the pixel data, whichever way it was stored
+    void release();
     // Filepath to the image loaded
     std::string m_filepath;
     // Raw pixel data
-    uint8_t* m_pixelData;
+    uint8_t* m_pixelData{nullptr};
     // Size and format of image
     int m_width{0}; // Width of the image
     int m_height{0}; // Height of the image
     int m_BPP{0};   // Bits per pixel (i.e. how colorful are our pixels)
 	std::string magicNumber; // magicNumber if any for image format
+    int m_channels{0}; // Samples per pixel: 1 gray, 2 gray alpha, 3 rgb, 4 rgba
+    int m_bytesPerSample{1};
+    int m_maxValue{255};
+    bool m_bigEndian{true};
+    // Pixels are read back to front
+    bool m_flip{false};
+    // Storage behind m_pixelData: parsed samples, a stb_image result,
+    // or a file mapping
+    std::vector<uint8_t> m_buffer;
+    uint8_t* m_stbData{nullptr};
+    void* m_mapping{nullptr};
+    std::size_t m_mappingSize{0};
 };
 
+// Write 8 bit RGB pixels, rows top first, as a PNG file
+// Returns false if the file could not be written.
+bool WritePNG(const std::string& path, int width, int height, const uint8_t* pixels);
+
 #endif
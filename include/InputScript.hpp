@@ -0,0 +1,57 @@
+#ifndef INPUTSCRIPT_HPP
+#define INPUTSCRIPT_HPP
+
+#if defined(LINUX) || defined(MINGW)
+    #include <SDL2/SDL.h>
+#else // This works for Mac
+    #include <SDL.h>
+#endif
+
+#include <string>
+#include <vector>
+
+// Frames of the built-in benchmark flight spent flying forward
+#define FLIGHT_FRAMES 600
+
+// Input handled at the start of one frame
+struct ScriptEvent {
+    unsigned int frame;
+    SDL_Event event;
+};
+
+// Purpose:
+// Input of a session frame by frame, recorded while playing or built in,
+// and replayed for benchmarks. Frames are fixed steps, so a replay
+// moves, looks and edits exactly like the recording no matter how long
+// its frames take. Saved as text, one event per line:
+//   <frame> key <SDL key name>
+//   <frame> motion <x> <y>
+//   <frame> click left|right
+//   <frame> end
+// Lines starting with # are comments. The script ends at the end line.
+class InputScript {
+public:
+    InputScript();
+    ~InputScript();
+    // Fly up from the spawn and circle over the terrain, digging and
+    // placing a block every few seconds
+    static InputScript Flight();
+    bool Load(const std::string& path);
+    bool Save(const std::string& path) const;
+    // Keep the key presses, mouse motion and clicks of a frame
+    void Record(unsigned int frame, const SDL_Event& event);
+    // Frame the script ends at
+    void SetLength(unsigned int frames);
+    unsigned int GetLength() const;
+    // Replace the input of the window with the events of frame
+    // Frames must be replayed in order.
+    void PushEvents(unsigned int frame);
+private:
+    void add(unsigned int frame, const SDL_Event& event);
+    std::vector<ScriptEvent> m_events;
+    unsigned int m_length;
+    // Next event to replay
+    std::size_t m_next;
+};
+
+#endif
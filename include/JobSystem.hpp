@@ -0,0 +1,73 @@
+#ifndef JOBSYSTEM_HPP
+#define JOBSYSTEM_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Purpose:
+// A pool of worker threads running jobs with work stealing.
+// Every worker owns a queue. Jobs submitted from a worker go to its own
+// queue, jobs submitted from any other thread are spread across the
+// queues. A worker takes the newest job of its own queue and, once that
+// is empty, steals the oldest job of another worker's queue.
+class JobSystem {
+public:
+    // Start workerCount threads, 0 picks one per core minus the main thread
+    JobSystem(unsigned int workerCount = 0);
+    // Finish the running jobs, drop the queued ones and join the workers
+    ~JobSystem();
+    // Queue a job to run on a worker thread
+    void Submit(std::function<void()> job);
+    // Help running jobs on the calling thread until every submitted job finished
+    void Wait();
+    // Call body(begin, end) over ranges covering [0, count) on the workers
+    // and the calling thread, and return once every range is done.
+    // Unlike Wait it only waits for its own ranges, so it can run while
+    // unrelated jobs are in flight.
+    void ParallelFor(int count, const std::function<void(int, int)>& body);
+    // Number of worker threads
+    unsigned int GetWorkerCount() const;
+private:
+    // Jobs of one worker, the owner works at the back and thieves at the front
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> jobs;
+    };
+    // Take a job, preferring the queue of worker index
+    bool popJob(unsigned int index, std::function<void()>& job);
+    // Run one job and count it as finished
+    void runJob(std::function<void()>& job);
+    // Body of worker thread index
+    void workerLoop(unsigned int index);
+    // Ranges of one ParallelFor, claimed in order by whoever is free
+    struct ParallelRanges {
+        const std::function<void(int, int)>* body;
+        int count;
+        int rangeSize;
+        std::atomic<int> nextRange{0};
+        std::atomic<int> finishedRanges{0};
+        int rangeCount;
+    };
+    // Run ranges of ranges until none is left to claim
+    static void runRanges(ParallelRanges& ranges);
+    std::vector<std::unique_ptr<WorkerQueue>> m_queues;
+    std::vector<std::thread> m_workers;
+    // Queue of the next job submitted from outside the pool
+    std::atomic<unsigned int> m_nextQueue{0};
+    // Jobs waiting in a queue
+    std::atomic<int> m_queuedJobs{0};
+    // Jobs submitted and not finished yet
+    std::atomic<int> m_unfinishedJobs{0};
+    std::atomic<bool> m_stop{false};
+    // Idle workers sleep here until a job is submitted
+    std::mutex m_sleepMutex;
+    std::condition_variable m_wake;
+};
+
+#endif
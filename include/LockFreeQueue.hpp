@@ -0,0 +1,57 @@
+#ifndef LOCKFREEQUEUE_HPP
+#define LOCKFREEQUEUE_HPP
+
+#include <atomic>
+#include <vector>
+
+// Purpose:
+// Queue that any number of threads push to without locking and one
+// thread drains. Pushes go onto an atomic linked list, PopAll takes the
+// whole list with one exchange and hands the items out in push order.
+template <typename T>
+class LockFreeQueue {
+public:
+    LockFreeQueue() {}
+
+    ~LockFreeQueue() {
+        std::vector<T> items;
+        PopAll(items);
+    }
+
+    LockFreeQueue(const LockFreeQueue&) = delete;
+    LockFreeQueue& operator=(const LockFreeQueue&) = delete;
+
+    // Safe to call from any thread
+    void Push(T item) {
+        Node* node = new Node{std::move(item), m_head.load(std::memory_order_relaxed)};
+        while (!m_head.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed)) {}
+    }
+
+    // Move every queued item to the end of out, oldest first
+    // Only one thread may drain the queue
+    void PopAll(std::vector<T>& out) {
+        Node* node = m_head.exchange(nullptr, std::memory_order_acquire);
+        // The list is newest first, reverse it
+        Node* reversed = nullptr;
+        while (node != nullptr) {
+            Node* next = node->next;
+            node->next = reversed;
+            reversed = node;
+            node = next;
+        }
+        while (reversed != nullptr) {
+            Node* next = reversed->next;
+            out.push_back(std::move(reversed->item));
+            delete reversed;
+            reversed = next;
+        }
+    }
+private:
+    struct Node {
+        T item;
+        Node* next;
+    };
+    std::atomic<Node*> m_head{nullptr};
+};
+
+#endif
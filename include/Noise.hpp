@@ -0,0 +1,33 @@
+#ifndef NOISE_HPP
+#define NOISE_HPP
+
+#include <cstdint>
+
+// Purpose:
+// Seeded fractal gradient (Perlin) noise on the x-z plane.
+// Points are evaluated in batches, 8 at a time with AVX2, 4 at a time
+// with SSE2 or one at a time otherwise, picked at compile time
+// (build with -mavx2 or -march=native for the AVX2 path). Every path
+// does the same float operations, so a seed gives the same terrain
+// whichever one runs, as long as the compiler does not fuse multiply-adds
+// (build.py passes -ffp-contract=off).
+class FractalNoise {
+public:
+    // octaves layers of noise, each lacunarity times the frequency and
+    // gain times the amplitude of the one before
+    FractalNoise(uint32_t seed, int octaves, float frequency, float lacunarity, float gain);
+    // Noise at x[i], z[i] for i < count, written to out[i], within [-1, 1]
+    void Sample(const float* x, const float* z, int count, float* out) const;
+    // Name of the instruction set Sample uses
+    static const char* GetSimdPath();
+private:
+    // Add amplitude times one octave of noise at x[i], z[i] to out[i]
+    void addOctave(const float* x, const float* z, int count, float frequency, float amplitude, uint32_t seed, float* out) const;
+    uint32_t m_seed;
+    int m_octaves;
+    float m_frequency;
+    float m_lacunarity;
+    float m_gain;
+};
+
+#endif
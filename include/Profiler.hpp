@@ -0,0 +1,107 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Scopes kept per thread, older ones are overwritten
+#define PROFILER_RING_SIZE (1 << 15)
+// Frames averaged by the per frame summary
+#define PROFILER_SUMMARY_FRAMES 60
+
+// Time the rest of the enclosing block under name, which must be a
+// string literal. Building with -D NO_PROFILER compiles it out.
+#if defined(NO_PROFILER)
+    #define PROFILE_SCOPE(name)
+#else
+    #define PROFILE_CONCAT_INNER(a, b) a##b
+    #define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+    #define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#endif
+
+// One timed scope, in nanoseconds since the profiler started
+struct ProfileEvent {
+    const char* name;
+    int64_t start;
+    int64_t end;
+    // Scopes open on the thread when this one started
+    uint32_t depth;
+};
+
+// Purpose:
+// Records timed scopes of every thread for the per frame summary and
+// Chrome trace export (chrome://tracing or ui.perfetto.dev).
+// Each thread writes its closed scopes to its own ring buffer without
+// locking, which costs two clock reads and a store per scope. Readers
+// copy a ring and drop whatever the thread overwrote during the copy,
+// so the summary and export can run while every thread keeps recording.
+class Profiler {
+public:
+    static Profiler& Instance();
+    // Name the calling thread in the summary and the trace
+    void SetThreadName(const std::string& name);
+    // Mark the start of a frame, called once per loop by the main thread
+    void MarkFrame();
+    // Print the time per frame of every scope over the last frames
+    void PrintSummary();
+    // Write every recorded scope as Chrome trace event JSON
+    bool WriteTrace(const std::string& path);
+    // Nanoseconds since the profiler started
+    int64_t Now() const;
+    // Called by ProfileScope
+    uint32_t BeginScope();
+    void EndScope(const char* name, int64_t start, uint32_t depth);
+private:
+    // Ring of one thread, only written by that thread
+    struct ThreadBuffer {
+        std::string name;
+        uint32_t id;
+        // Scopes open on the thread
+        uint32_t depth;
+        // Scopes written so far, the newest is at (written - 1) % size
+        std::atomic<uint64_t> written;
+        ProfileEvent events[PROFILER_RING_SIZE];
+    };
+    Profiler();
+    // Buffer of the calling thread, registered on first use
+    ThreadBuffer& threadBuffer();
+    // Names and buffers of the threads registered so far
+    void listThreads(std::vector<std::string>& names, std::vector<const ThreadBuffer*>& buffers);
+    // Copy the scopes of a ring the thread has not overwritten
+    static void copyEvents(const ThreadBuffer& buffer, std::vector<ProfileEvent>& events);
+    // Buffer of the calling thread, null until it records its first scope
+    static thread_local ThreadBuffer* m_threadBuffer;
+    std::chrono::steady_clock::time_point m_start;
+    // Buffers of every thread that recorded a scope, kept after it exits
+    std::vector<std::unique_ptr<ThreadBuffer>> m_buffers;
+    std::mutex m_mutex;
+    // Starts of the last frames, the newest at (m_frames - 1) % size
+    int64_t m_frameStarts[PROFILER_SUMMARY_FRAMES + 1];
+    uint64_t m_frames;
+};
+
+// Times its own lifetime
+class ProfileScope {
+public:
+    ProfileScope(const char* name) : m_name(name) {
+        Profiler& profiler = Profiler::Instance();
+        m_depth = profiler.BeginScope();
+        m_start = profiler.Now();
+    }
+    ~ProfileScope() {
+        Profiler::Instance().EndScope(m_name, m_start, m_depth);
+    }
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+private:
+    const char* m_name;
+    int64_t m_start;
+    uint32_t m_depth;
+};
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef RAYCAST_HPP
+#define RAYCAST_HPP
+
+#include "glm/glm.hpp"
+
+#include "BlockData.hpp"
+
+// Block hit by a ray and the face (BlockFace) the ray entered through
+struct RaycastHit {
+    int x;
+    int y;
+    int z;
+    int face;
+};
+
+// Walk the block grid from origin along direction (Amanatides and Woo,
+// "A Fast Voxel Traversal Algorithm for Ray Tracing") and return true at
+// the first visible block within maxDistance. The block the ray starts in
+// is skipped, since no face of it can be seen.
+bool RaycastBlocks(const BlocksArray& blocksArray, const glm::vec3& origin, const glm::vec3& direction, float maxDistance, RaycastHit& hit);
+
+#endif
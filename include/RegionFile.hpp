@@ -0,0 +1,123 @@
+#ifndef REGIONFILE_HPP
+#define REGIONFILE_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "BlockData.hpp"
+#include "TerrainGenerator.hpp"
+
+// Chunk columns along each side of a region file
+#define REGION_SHIFT 5
+#define REGION_SIZE (1 << REGION_SHIFT)
+#define REGION_COLUMNS (REGION_SIZE * REGION_SIZE)
+// Column records are stored in whole sectors, small since a compressed
+// column is typically well under a kilobyte
+#define REGION_SECTOR_SIZE 512
+// Magic, version and the offset table of every column
+#define REGION_HEADER_BYTES (8 + REGION_COLUMNS * 8)
+#define REGION_HEADER_SECTORS ((REGION_HEADER_BYTES + REGION_SECTOR_SIZE - 1) / REGION_SECTOR_SIZE)
+#define REGION_VERSION 1
+
+// Purpose:
+// One file holding the saved chunk columns of a REGION_SIZE x
+// REGION_SIZE area. The header starts with "MCRG" and the version,
+// followed by one entry per column (index x + z * REGION_SIZE) holding
+// the first sector and the byte size of its record, zero if the column
+// was never saved. All numbers are little endian.
+// Records are written to free sectors and synced to disk before their
+// header entries are switched to them, and only then are the sectors of
+// the old records freed. Like writing a temporary file and renaming it
+// over the old one, a crash at any point leaves every column either
+// old or new, but without rewriting the columns that did not change.
+class RegionFile {
+public:
+    RegionFile(const std::string& path);
+    ~RegionFile();
+    // Open the file, creating an empty region if it does not exist
+    // Returns false if it cannot be created or is not a region file.
+    bool Open();
+    // Read the record of column index, false if it was never saved
+    bool Read(int index, std::vector<uint8_t>& record);
+    // Replace the records of the columns at indices
+    bool Write(const std::vector<int>& indices, const std::vector<const std::vector<uint8_t>*>& records);
+    // Indices of the columns saved in the file
+    void GetColumns(std::vector<int>& indices);
+private:
+    struct Entry {
+        uint32_t sector;
+        uint32_t size;
+    };
+    // First run of count free sectors, growing the file if there is none
+    uint32_t allocate(uint32_t count);
+    // Mark the sectors of a record used or free
+    void markSectors(const Entry& entry, bool used);
+    // Flush buffered writes and wait until they reach the disk
+    bool sync();
+    std::string m_path;
+    FILE* m_file;
+    Entry m_table[REGION_COLUMNS];
+    // Whether each sector of the file holds the header or a record
+    std::vector<bool> m_usedSectors;
+    // Reads and writes come from the workers and the main thread
+    std::mutex m_mutex;
+};
+
+// Totals of the region store, updated from any thread
+struct RegionStats {
+    unsigned int columnsLoaded;
+    unsigned int columnsSaved;
+    // Serialized bytes of the encoded columns and the bytes of the
+    // compressed records written
+    std::size_t rawBytes;
+    std::size_t compressedBytes;
+    double loadSeconds;
+    // Time spent encoding and writing columns
+    double saveSeconds;
+};
+
+// Purpose:
+// Saves and loads chunk columns in region files inside a directory,
+// named r.<regionX>.<regionZ>.mcr. A column record is the size of the
+// serialized column followed by its LZ4 block. The serialized column
+// is the number of sections, then for each section its layer, index
+// width, palette size - 1, palette and packed indices. Face masks are
+// not stored, they are recomputed once the column is in the world.
+// Safe to use from several threads at once.
+class RegionStore {
+public:
+    // Columns hold the sections of a world worldHeight blocks high
+    RegionStore(const std::string& directory, int worldHeight);
+    ~RegionStore();
+    // Create the directory if needed
+    bool Open();
+    // Fill column with the saved sections of column.chunkX, column.chunkZ
+    // Returns false if the column was never saved or its record is corrupt.
+    bool LoadColumn(GeneratedColumn& column);
+    // Serialize and compress a column of the world into a record
+    // Only reads the world, so columns can be encoded on several threads.
+    void EncodeColumn(const BlocksArray& blocksArray, int chunkX, int chunkZ, std::vector<uint8_t>& record);
+    // Write the records of columns, a batch per region file
+    bool WriteColumns(const std::vector<ChunkCoord>& columns, const std::vector<std::vector<uint8_t>>& records);
+    // Columns saved in every region file of the directory, keyed with y = 0
+    void ListColumns(std::vector<ChunkCoord>& columns);
+    const std::string& GetDirectory() const;
+    RegionStats GetStats();
+private:
+    // Region file containing a column, opened on first use
+    // A missing file is only created when create is set.
+    RegionFile* regionOf(int chunkX, int chunkZ, bool create);
+    std::string m_directory;
+    int m_worldHeight;
+    // Guards the open regions and the stats
+    std::mutex m_mutex;
+    std::unordered_map<ChunkCoord, std::unique_ptr<RegionFile>, ChunkCoordHash> m_regions;
+    RegionStats m_stats;
+};
+
+#endif
@@ -17,10 +17,56 @@
 
 // The glad library helps setup OpenGL extensions.
 #include <glad/glad.h>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include "Benchmark.hpp"
 #include "BlockBuilder.hpp"
 #include "BlockData.hpp"
+#include "CameraUniforms.hpp"
 #include "Crosshair.hpp"
-#include "SelectionFrameBuffer.hpp"
+#include "FrameBuffer.hpp"
+#include "InputScript.hpp"
+#include "JobSystem.hpp"
+#include "RegionFile.hpp"
+#include "WorldSaver.hpp"
+#include "WorldSnapshot.hpp"
+#include "TerrainGenerator.hpp"
+#include "WorldStreamer.hpp"
+
+// Where the terrain of the world comes from
+struct WorldSettings {
+    // Heightmap imported once as a fixed world, nothing streams in around it
+    std::string import;
+    // Heightmap tiled across the world, empty for generated terrain
+    std::string heightmap;
+    // Seed of the generated terrain
+    uint32_t seed{1337};
+    // Directory of the region files the world is saved to and loaded
+    // from, empty to keep nothing
+    std::string save;
+    // Seconds between autosaves of the edited columns, 0 to only save
+    // on exit and as columns unload
+    double autosaveInterval{AUTOSAVE_INTERVAL};
+    // Flat snapshot of the whole world, started from when it exists and
+    // written once the world is built and on exit; empty for none
+    std::string snapshot;
+    // Chunk columns kept loaded around the camera, in chunks
+    int viewDistance{STREAM_RADIUS};
+};
+
+// How frames are shown
+struct DisplaySettings {
+    // Render offscreen in a hidden window and ignore input, for batch
+    // runs on machines without a display or GPU
+    bool headless{false};
+    // Frames to run before quitting, 0 to run until closed
+    unsigned int frames{0};
+    // Directory headless frames are written to as PNG, empty for none
+    std::string dumpDirectory;
+    // Write every dumpInterval-th frame
+    unsigned int dumpInterval{1};
+};
 
 // Purpose:
 // This class sets up a full graphics program using SDL
@@ -28,21 +74,26 @@ class SDLGraphicsProgram {
 public:
 
     // Constructor
-    SDLGraphicsProgram(int w, int h);
+    SDLGraphicsProgram(int w, int h, const WorldSettings& world = WorldSettings(),
+                       const DisplaySettings& display = DisplaySettings());
     // Destructor
     ~SDLGraphicsProgram();
     // Setup OpenGL
     bool InitGL();
-    // Generate blocks for world
-    void InitWorld();
-    // Per frame update
+    // Generate the world around the camera
+    void InitWorld(const WorldSettings& world);
+    // Per frame update, streams the world around the camera
     void Update();
     // Renders shapes to the screen
     void Render();
     // Loop that runs forever
     void Loop();
-    // Get selected block at cursor position
-    void MakeSelection(int x, int y, int clickType);
+    // Replay script instead of taking input, then report and quit
+    void SetBenchmark(const InputScript& script, const std::string& reportPath);
+    // Record the input of the session to an input script saved on exit
+    void SetRecording(const std::string& path);
+    // Destroy or place a block at the one under the crosshair
+    void MakeSelection(int clickType);
     // Get Pointer to Window
     SDL_Window* GetSDLWindow();
     // Helper Function to Query OpenGL information.
@@ -56,13 +107,42 @@ private:
     SDL_Window* m_window;
     // OpenGL context
     SDL_GLContext m_openGLContext;
+    // When construction started, for the startup time report
+    std::chrono::steady_clock::time_point m_startTime;
+    DisplaySettings m_display;
+    // Headless frames are drawn here, null when drawing to the window
+    std::unique_ptr<FrameBuffer> offscreen;
 
-    SelectionFrameBuffer selectionBuffer;
+    // Camera matrices shared by all block shaders
+    CameraUniforms cameraUniforms;
     BlockBuilder builder;
     Crosshair crosshair;
     BlocksArray blocksArray;
     BlockType activeBlock;
+    // Terrain of the chunk columns streamed in around the camera
+    std::unique_ptr<TerrainGenerator> terrain;
+    // Saved columns, null when the world is not saved
+    std::unique_ptr<RegionStore> store;
+    // Writes edited columns to the store in the background
+    std::unique_ptr<WorldSaver> saver;
+    // Snapshot file written on exit, empty for none
+    std::string snapshotPath;
+    // Replays input and measures frames, null when not benchmarking
+    std::unique_ptr<Benchmark> benchmark;
+    // Input recorded so far and where it is saved, null when not recording
+    std::unique_ptr<InputScript> recording;
+    std::string recordingPath;
+    WorldStreamer streamer;
+    // Worker threads, declared last so they are joined before the
+    // objects their jobs use are destroyed
+    JobSystem jobs;
 
+    // Import a heightmap as the world, tile by tile
+    void importWorld(const std::string& path);
+    // Save columns of the world, spread across the workers
+    void saveColumns(const std::vector<ChunkCoord>& columns);
+    // Write the offscreen frame to the dump directory
+    void dumpFrame(unsigned int frame);
     // void updateSurroundingBlocks(int x, int y, int z);
 };
 
@@ -2,6 +2,7 @@
 #define SHADER_HPP
 
 #include <string>
+#include <unordered_map>
 
 #if defined(LINUX) || defined(MINGW)
     #include <SDL2/SDL.h>
@@ -27,12 +28,15 @@ public:
     void CreateShader(const std::string& vertexShaderSource, const std::string& fragmentShaderSource);
     // return the shader id
     GLuint GetID() const;
+    // Read a uniform block from the buffer attached to binding
+    void BindUniformBlock(const GLchar* name, GLuint binding);
     // Set our uniforms for our shader.
     void SetUniformMatrix4fv(const GLchar* name, const GLfloat* value);
     void SetUniformMatrix1i(const GLchar* name, int value);
     void SetUniform4f(const GLchar* name, float v0, float v1, float v2, float v3);
     void SetUniform1f(const GLchar* name, float value);
     void SetUniform3f(const GLchar* name, float v0, float v1, float v2);
+    void SetUniform2uiv(const GLchar* name, int count, const GLuint* values);
 private:
     // Compiles loaded shaders
     unsigned int CompileShader(unsigned int type, const std::string& source);
@@ -43,8 +47,14 @@ private:
     void PrintShaderLog( GLuint shader );
     // Logs an error message 
     void Log(const char* system, const char* message);
+    // Look up all active uniforms of the linked program
+    void CacheUniformLocations();
+    // Location of a uniform, -1 if the program does not use it
+    GLint GetUniformLocation(const GLchar* name) const;
     // The unique shaderID
     GLuint m_shaderID;
+    // Uniform locations of the linked program by name
+    std::unordered_map<std::string, GLint> m_uniformLocations;
 };
 
 #endif
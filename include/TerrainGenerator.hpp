@@ -0,0 +1,101 @@
+#ifndef TERRAINGENERATOR_HPP
+#define TERRAINGENERATOR_HPP
+
+#include <memory>
+#include <vector>
+
+#include "BlockData.hpp"
+#include "Image.hpp"
+#include "Noise.hpp"
+
+// Chunks of one chunk column, built off the world by a generator
+struct GeneratedColumn {
+    // Column position in chunk units, the x and z of its chunks
+    int chunkX;
+    int chunkZ;
+    // Chunks from the bottom of the world up, nullptr where all air
+    std::vector<std::unique_ptr<Chunk>> layers;
+};
+
+// Terrain heights of a rectangle of block columns
+struct HeightTile {
+    // World x, z of the first block column
+    int x;
+    int z;
+    int width;
+    int depth;
+    // Height in blocks of every block column, x major
+    std::vector<int> heights;
+};
+
+// Build the chunk columns covered by a tile and fill every block column
+// up to its height: grass on top, or snow above height 36, and dirt
+// below it. A height at or above the world height leaves the block
+// column empty. Parts of a chunk column outside the tile stay air.
+// The chunk columns are appended to columns, x major, with their
+// palettes compacted. Only reads the tile, so tiles can be filled in
+// parallel.
+void FillTerrainTile(const HeightTile& tile, int worldHeight, std::vector<GeneratedColumn>& columns);
+
+// Purpose:
+// Produces the terrain of the world one chunk column at a time.
+// GenerateColumn only reads data fixed at construction, so workers can
+// generate different columns in parallel.
+class TerrainGenerator {
+public:
+    // worldHeight is the height of the world in blocks
+    TerrainGenerator(int worldHeight);
+    virtual ~TerrainGenerator();
+    // Fill column.layers for the chunk column at column.chunkX, chunkZ
+    virtual void GenerateColumn(GeneratedColumn& column) const = 0;
+protected:
+    // Fill column from a tile covering exactly that chunk column
+    void fillFromTile(const HeightTile& tile, GeneratedColumn& column) const;
+    int m_worldHeight;
+};
+
+// Purpose:
+// Terrain from a heightmap image, the red or gray channel scaled from
+// 0-GetMaxValue() to the world height, so 16 bit maps keep their detail.
+// The image is mirrored across its edges so it tiles the unbounded world
+// without seams. Heights are read from the image as columns are
+// generated, so a memory mapped image is only paged in where the world
+// has been.
+class HeightmapTerrain : public TerrainGenerator {
+public:
+    // Takes a loaded image
+    HeightmapTerrain(std::unique_ptr<Image> image, int worldHeight);
+    ~HeightmapTerrain();
+    void GenerateColumn(GeneratedColumn& column) const override;
+private:
+    std::unique_ptr<Image> m_image;
+};
+
+// Terrain height of NoiseTerrain where the noise is zero, and the
+// number of blocks a noise of 1 adds to it
+#define NOISE_TERRAIN_BASE 32
+#define NOISE_TERRAIN_AMPLITUDE 56
+
+// Purpose:
+// Endless terrain from seeded fractal noise. The same seed always gives
+// the same world, with snow capping the hills above height 36.
+class NoiseTerrain : public TerrainGenerator {
+public:
+    NoiseTerrain(uint32_t seed, int worldHeight);
+    ~NoiseTerrain();
+    void GenerateColumn(GeneratedColumn& column) const override;
+private:
+    FractalNoise m_noise;
+};
+
+// Purpose:
+// No terrain, every column is air. Surrounds an imported world whose
+// columns are streamed in from its region files.
+class EmptyTerrain : public TerrainGenerator {
+public:
+    EmptyTerrain(int worldHeight);
+    ~EmptyTerrain();
+    void GenerateColumn(GeneratedColumn& column) const override;
+};
+
+#endif
@@ -32,14 +32,30 @@ public:
     // Format is: x,y,z, s,t
     void CreateTextureBufferLayout(unsigned int vcount, unsigned int tcount, unsigned int icount, float* vdata, float* tdata, unsigned int* idata);
 
+    // Creates (or refills) a vertex and index buffer object
+    // Format is: two packed unsigned ints per vertex (see ChunkMesher.hpp)
+    // Calling this again replaces the data in the existing buffers,
+    // which is how chunk meshes are rebuilt.
+    void CreateChunkBufferLayout(unsigned int vcount, unsigned int icount, const unsigned int* vdata, const unsigned int* idata);
+
+    // Creates (or refills) a per-instance buffer on an existing layout
+    // Format is: x,y,z, blockType | faceMask << 8 as ints, read as attribute 3
+    // count: the number of ints
+    void SetInstanceData(unsigned int count, const int* data);
+    // Make instance 0 of the next draw read the instance at first
+    // GL 3.3 has no base instance, so the attribute is rebound instead
+    void SetFirstInstance(unsigned int first);
+
 private:
     // Vertex Array Object
-    GLuint m_VAOId;
+    GLuint m_VAOId{0};
     // Vertex Buffer
-    GLuint m_vertexPositionBuffer;
-    GLuint m_textureCoordinatesBuffer;
+    GLuint m_vertexPositionBuffer{0};
+    GLuint m_textureCoordinatesBuffer{0};
+    // Per-instance data
+    GLuint m_instanceBuffer{0};
     // Index Buffer Object
-    GLuint m_indexBufferObject;
+    GLuint m_indexBufferObject{0};
     // Stride of data (how do I get to the next vertex)
     unsigned int m_stride{0};
 };
@@ -0,0 +1,95 @@
+#ifndef WORLDSAVER_HPP
+#define WORLDSAVER_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include "BlockData.hpp"
+#include "RegionFile.hpp"
+#include "TerrainGenerator.hpp"
+
+// Seconds between autosaves of the edited columns
+#define AUTOSAVE_INTERVAL 30.0
+
+// Autosave counters
+struct SaveStats {
+    // Snapshots taken by Update and Flush
+    unsigned int autosaves;
+    unsigned int columnsSaved;
+    // Compressed bytes written and the time the saver thread spent
+    // encoding and writing them
+    std::size_t bytesWritten;
+    double writeSeconds;
+    // Main thread time spent taking snapshots, the only part of a save
+    // the loop waits for
+    double lastPauseSeconds;
+    double maxPauseSeconds;
+    // Columns snapshot and not written yet
+    unsigned int queuedColumns;
+};
+
+// Purpose:
+// Saves edited columns to a region store in the background. Every
+// interval the main thread copies the palette sections of the columns
+// edited since the last save, which takes microseconds per column. A
+// saver thread then serializes, compresses and writes the copies, so
+// the loop never waits for compression or the disk. Until a copy is
+// written, loading its column returns the copy, so a column unloaded
+// and loaded again right away never reads an older save.
+class WorldSaver {
+public:
+    // Save to store, which must outlive the saver
+    WorldSaver(RegionStore* store);
+    // Write every queued column and stop the saver thread
+    ~WorldSaver();
+    // Seconds between autosaves, 0 saves only on unload and Flush
+    void SetInterval(double seconds);
+    // Per frame: snapshot the edited columns once the interval has passed
+    void Update(BlocksArray& blocksArray);
+    // Snapshot one column to be written, for columns about to be unloaded
+    void SaveColumn(const BlocksArray& blocksArray, const ChunkCoord& column);
+    // Snapshot every edited column and wait until all are written
+    void Flush(BlocksArray& blocksArray);
+    // Fill column from a queued snapshot or the store, safe from any thread
+    bool LoadColumn(GeneratedColumn& column);
+    SaveStats GetStats();
+private:
+    // Copy of the sections of one column, enough to encode it
+    struct ColumnSnapshot {
+        ChunkCoord column;
+        BlocksArray blocks;
+        // Set once the saver thread took it from the queue
+        bool taken;
+    };
+    // Snapshot the columns of the world edited since the last save
+    void snapshotEdited(BlocksArray& blocksArray);
+    // Copy a column and queue it, m_mutex must be held
+    void queueSnapshot(const BlocksArray& blocksArray, const ChunkCoord& column);
+    // Body of the saver thread
+    void saverLoop();
+    RegionStore* m_store;
+    double m_interval;
+    std::chrono::steady_clock::time_point m_lastSave;
+    // Newest snapshot of each queued column, kept until it is written
+    std::unordered_map<ChunkCoord, std::shared_ptr<ColumnSnapshot>, ChunkCoordHash> m_snapshots;
+    // Columns waiting for the saver thread, each listed once
+    std::deque<ChunkCoord> m_queue;
+    // Columns taken by the saver thread and not written yet
+    unsigned int m_writing;
+    bool m_stop;
+    std::mutex m_mutex;
+    // Wakes the saver thread when columns are queued
+    std::condition_variable m_queued;
+    // Wakes Flush when the saver thread finishes a batch
+    std::condition_variable m_written;
+    SaveStats m_stats;
+    // Started last, once everything it uses is initialized
+    std::thread m_thread;
+};
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef WORLDSNAPSHOT_HPP
+#define WORLDSNAPSHOT_HPP
+
+#include <string>
+
+#include "glm/vec3.hpp"
+
+#include "BlockData.hpp"
+#include "JobSystem.hpp"
+
+#define SNAPSHOT_VERSION 1
+
+// Purpose:
+// Flat file of every chunk in the world, in the layout the chunks have
+// in memory, for starting a pre-built world without generating,
+// decompressing or computing face masks. A header (magic "MCSN",
+// version, byte order, world height, chunk count, file size and the
+// camera position) is followed by one directory entry per chunk and
+// then the chunk data, each part 8 byte aligned: palette, packed
+// indices, and the solid columns and face masks when the chunk has
+// them. Numbers are in the byte order of the machine that wrote it,
+// a snapshot from another byte order is rejected.
+// Loading maps the file, checks every entry against the file bounds and
+// the invariants of a section, and copies the sections out in parallel.
+// Chunks own their arrays, so the data is copied out of the mapping
+// rather than used in place, which costs about one memcpy of the file.
+class WorldSnapshot {
+public:
+    WorldSnapshot(const std::string& path);
+    ~WorldSnapshot();
+    // Add the chunks of the snapshot to blocksArray and set eye to the
+    // camera position it was taken at
+    // Returns false, leaving blocksArray as it was, if the file is
+    // missing, was written for another world height or fails validation.
+    bool Load(BlocksArray& blocksArray, JobSystem* jobs, glm::vec3& eye);
+    // Write every chunk of blocksArray and the camera position
+    // The file is written under a temporary name and renamed over the
+    // old snapshot, so an interrupted save keeps the previous one.
+    bool Save(const BlocksArray& blocksArray, const glm::vec3& eye);
+private:
+    std::string m_path;
+};
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef WORLDSTREAMER_HPP
+#define WORLDSTREAMER_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <unordered_set>
+#include <vector>
+
+#include "glm/vec3.hpp"
+
+#include "BlockData.hpp"
+#include "JobSystem.hpp"
+#include "LockFreeQueue.hpp"
+#include "WorldSaver.hpp"
+#include "TerrainGenerator.hpp"
+
+// Chunk columns kept loaded around the camera, in chunks
+#define STREAM_RADIUS 8
+// Extra distance, in chunks, a column may drift out of the radius before
+// it is unloaded, so walking along the edge does not reload it each step
+#define STREAM_HYSTERESIS 2
+// Column generations started per frame
+#define GENERATION_REQUESTS_PER_FRAME 8
+// Column generations in flight at once, bounds the work queued when
+// the camera moves faster than columns are generated
+#define MAX_PENDING_COLUMNS 32
+
+// Compute the face masks of the chunks at coords, spread across jobs
+// when given. changed[i] is set when the masks of chunk i changed.
+void ComputeFaceMasks(BlocksArray& blocksArray, const std::vector<ChunkCoord>& coords, JobSystem* jobs, std::vector<char>& changed);
+
+// Counters of the streamed world
+struct StreamStats {
+    unsigned int loadedColumns;
+    unsigned int pendingColumns;
+    unsigned int columnsLoaded;
+    unsigned int columnsUnloaded;
+    // Columns generated so far and the time workers spent on them
+    unsigned int columnsGenerated;
+    double generationSeconds;
+};
+
+// Purpose:
+// Keeps the chunk columns within a radius of the camera loaded.
+// Missing columns are loaded from the store or generated on worker
+// threads, nearest and most in view first, and added to the world on
+// the main thread. Columns beyond the radius plus a hysteresis margin
+// are unloaded, so memory is bounded by the view distance instead of
+// the size of the world. Edited columns are saved before unloading.
+class WorldStreamer {
+public:
+    WorldStreamer();
+    ~WorldStreamer();
+    // Terrain of the columns loaded from now on, must outlive the streamer
+    void SetGenerator(const TerrainGenerator* generator);
+    // Generate columns on the workers of jobs instead of the main thread
+    void SetJobSystem(JobSystem* jobs);
+    // Load saved columns through saver instead of generating them, and
+    // hand edited columns to it before they are unloaded
+    void SetSaver(WorldSaver* saver);
+    // Columns within radius chunks of the camera are loaded, columns
+    // beyond radius + hysteresis chunks are unloaded
+    void SetViewRadius(int radius, int hysteresis);
+    // Generate every missing column in range of eye and wait for them
+    void LoadAround(BlocksArray& blocksArray, const glm::vec3& eye);
+    // Count the columns already in the world as loaded, for a world
+    // restored from a snapshot
+    void AdoptColumns(const BlocksArray& blocksArray);
+    // Per frame: add generated columns, start generating missing ones
+    // and unload the ones left behind
+    void Update(BlocksArray& blocksArray, const glm::vec3& eye, const glm::vec3& viewDirection);
+    const StreamStats& GetStats();
+private:
+    // Distance in blocks from eye to the center of a column, on the x-z plane
+    float columnDistance(const ChunkCoord& column, const glm::vec3& eye) const;
+    // Start loading or generating a column
+    void requestColumn(const ChunkCoord& column);
+    // Move the generated columns still in range into the world
+    void addColumns(BlocksArray& blocksArray, std::vector<std::unique_ptr<GeneratedColumn>>& columns, const glm::vec3& eye);
+    // Recompute the face masks of the loaded columns among columns and
+    // their neighbors, marking the chunks whose masks changed
+    void refreshColumns(BlocksArray& blocksArray, const std::vector<ChunkCoord>& columns);
+    // Start generating the missing columns nearest to eye, favoring the view direction
+    void requestMissingColumns(const glm::vec3& eye, const glm::vec3& viewDirection);
+    // Unload the columns beyond the radius plus hysteresis
+    void unloadDistantColumns(BlocksArray& blocksArray, const glm::vec3& eye);
+    const TerrainGenerator* m_generator;
+    JobSystem* m_jobs;
+    WorldSaver* m_saver;
+    int m_radius;
+    int m_hysteresis;
+    // Columns in the world and columns being generated, keyed with y = 0
+    std::unordered_set<ChunkCoord, ChunkCoordHash> m_loadedColumns;
+    std::unordered_set<ChunkCoord, ChunkCoordHash> m_pendingColumns;
+    // Columns finished by workers, drained by the main thread
+    LockFreeQueue<std::unique_ptr<GeneratedColumn>> m_finishedColumns;
+    // Updated by the workers
+    std::atomic<unsigned int> m_columnsGenerated{0};
+    std::atomic<uint64_t> m_generationNanoseconds{0};
+    StreamStats m_stats;
+};
+
+#endif
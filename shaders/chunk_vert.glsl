@@ -0,0 +1,52 @@
+// ==================================================================
+#version 330 core
+
+// Chunk mesh vertices are packed into two unsigned ints (see ChunkMesher.hpp)
+//   x: corner x,y,z (5 bits each), face (3 bits), s,t (5 bits each)
+//   y: atlas tile index
+layout(location=0) in uvec2 packedVertex;
+
+out vec2 v_texCoord;
+flat out vec2 v_tileOrigin;
+out vec3 myNormal;
+out vec3 FragPos;
+
+// Chunk origin in world space
+uniform vec3 blockOffset;
+// View and projection of the current frame, shared by all block shaders
+layout(std140) uniform CameraUniforms {
+  mat4 view;
+  mat4 projection;
+};
+
+// Normal of each face in BlockFace order
+const vec3 faceNormals[6] = vec3[6](
+  vec3(0.0, 0.0, 1.0), vec3(0.0, 0.0, -1.0),
+  vec3(0.0, 1.0, 0.0), vec3(0.0, -1.0, 0.0),
+  vec3(1.0, 0.0, 0.0), vec3(-1.0, 0.0, 0.0)
+);
+
+// The atlas is a 16x16 grid of tiles, tile 0 is its top left
+const float ATLAS_TILES = 16.0;
+
+void main()
+{
+  uint bits = packedVertex.x;
+  // Corners are stored half a block up so they are never negative
+  vec3 corner = vec3(float(bits & 31u), float((bits >> 5) & 31u), float((bits >> 10) & 31u)) - 0.5;
+  uint face = (bits >> 15) & 7u;
+
+  vec3 worldPosition = corner + blockOffset;
+  gl_Position = projection * view * vec4(worldPosition, 1.0f);
+  myNormal = faceNormals[face];
+  FragPos = worldPosition;
+
+  // Texture coordinates count blocks, the fragment shader wraps them into the tile
+  v_texCoord = vec2(float((bits >> 18) & 31u), float((bits >> 23) & 31u));
+  float tile = float(packedVertex.y & 255u);
+  float column = mod(tile, ATLAS_TILES);
+  float row = floor(tile / ATLAS_TILES);
+  // Same inset as BlockBuilder::generateFaceTexture
+  v_tileOrigin = vec2(column / ATLAS_TILES + 0.001, (ATLAS_TILES - row - 1.0) / ATLAS_TILES + 0.001);
+}
+// ==================================================================
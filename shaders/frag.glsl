@@ -8,6 +8,12 @@ out vec4 color;
 // shader.
 in vec2 v_texCoord;
 
+// Texture coordinates count blocks and the atlas tile starting at
+// v_tileOrigin is repeated across the face. Chunk meshes merge faces
+// into quads spanning several blocks, individual cubes span one.
+flat in vec2 v_tileOrigin;
+uniform float atlasTileSize;
+
 // If we have texture coordinates,
 // they are stored in a sampler.
 // By convention, we often name uniforms
@@ -79,6 +85,10 @@ vec3 calcLightingDebug(vec3 norm) {
     return diffuseLight + ambient + specular;
 }
 
+vec2 atlasCoord() {
+    return v_tileOrigin + fract(v_texCoord) * atlasTileSize;
+}
+
 void main()
 {
     if (lightingEnabled == 1) {
@@ -86,7 +96,7 @@ void main()
         vec3 norm = normalize(myNormal);
 
         // Store our final texture color
-        vec3 diffuseColor = texture(u_Texture, v_texCoord).rgb;
+        vec3 diffuseColor = texture(u_Texture, atlasCoord()).rgb;
 
         vec3 totalLighting = vec3(0, 0, 0);
         for (int i = 0; i < NUM_LIGHTS; i++) {
@@ -97,7 +107,7 @@ void main()
         color = vec4(diffuseColor * totalLighting, 1.0);
     }
     else {
-        color = texture(u_Texture, v_texCoord);
+        color = texture(u_Texture, atlasCoord());
     }
 
 }
@@ -1,11 +0,0 @@
-// ==================================================================
-#version 330 core
-
-out vec4 FragColor;
-uniform vec4 blockColor;
-
-void main()
-{
-    FragColor = blockColor;
-}
-// ==================================================================
\ No newline at end of file
@@ -9,6 +9,9 @@ layout(location=0)in vec3 position; // We explicitly state which is the vertex
 // vertex buffer object (VBO) layout.
 layout(location=1) in vec3 normals;
 layout(location=2) in vec2 texCoord;
+// One per cube instance: world x,y,z of the block, its block type
+// in the low 8 bits of w and the mask of its exposed faces above that
+layout(location=3) in ivec4 instanceData;
 
 // If we have texture coordinates we will need
 // to pass these into the fragment shader.
@@ -17,31 +20,59 @@ layout(location=2) in vec2 texCoord;
 // a later stage of the graphics
 // pipeline (i.e. our fragment shader)
 out vec2 v_texCoord;
+flat out vec2 v_tileOrigin;
 out vec3 myNormal;
 out vec3 FragPos;
 
 // If we are applying our camera, then we need to add some uniforms.
 // Recall that the vertex positions 'vec3 postion' are the objects
 // positions in 'local space'
-// Then we have the 'modelTransformMatrix' which is part of the model view
-// transformation.
+// Blocks are only ever translated, so 'blockOffset' plus the position
+// of the instance take the place of a full model matrix.
 // And finally the 'projectionMatrix' which will transform our vertices
 // into our chosen projection (i.e. for us, a perspective view).
+// Both are set once per frame in the CameraUniforms block.
 //
 // Note: that the syntax nicely matches glm's mat4!
 //
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+uniform vec3 blockOffset;
+// View and projection of the current frame, shared by all block shaders
+layout(std140) uniform CameraUniforms {
+  mat4 view;
+  mat4 projection;
+};
+
+// Atlas tiles of every block type, 8 bits per face:
+// faces 0-3 in x and faces 4-5 in y
+#define MAX_BLOCK_TYPES 64
+uniform uvec2 blockTiles[MAX_BLOCK_TYPES];
+
+// The atlas is a 16x16 grid of tiles, tile 0 is its top left
+const float ATLAS_TILES = 16.0;
 
 void main()
 {
-  gl_Position = projection * view * model * vec4(position, 1.0f);
+  vec3 worldPosition = position + vec3(instanceData.xyz) + blockOffset;
+  gl_Position = projection * view * vec4(worldPosition, 1.0f);
+  // Each face of the cube has 4 vertices, in BlockFace order
+  int face = gl_VertexID / 4;
+  // Move all corners of a covered face to one point beyond the far
+  // plane, so its triangles are degenerate and clipped
+  int faceMask = instanceData.w >> 8;
+  if (((faceMask >> face) & 1) == 0) {
+    gl_Position = vec4(0.0, 0.0, 2.0, 1.0);
+  }
   myNormal = normals;
-  FragPos = vec3(model * vec4(position, 1.0f));
+  FragPos = worldPosition;
 
   // Store the texture coordinates which we will output to
   // the next stage in the graphics pipeline.
   v_texCoord = texCoord;
+  uvec2 tiles = blockTiles[instanceData.w & 255];
+  uint tile = ((face < 4 ? tiles.x : tiles.y) >> uint(8 * (face % 4))) & 255u;
+  float column = mod(float(tile), ATLAS_TILES);
+  float row = floor(float(tile) / ATLAS_TILES);
+  // Same inset as BlockBuilder::generateFaceTexture
+  v_tileOrigin = vec2(column / ATLAS_TILES + 0.001, (ATLAS_TILES - row - 1.0) / ATLAS_TILES + 0.001);
 }
 // ==================================================================
@@ -0,0 +1,118 @@
+#include "Benchmark.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <sstream>
+#if !defined(_WIN32)
+#include <sys/resource.h>
+#endif
+
+Benchmark::Benchmark(const InputScript& script, const std::string& reportPath) :
+    m_script(script), m_reportPath(reportPath) {
+    m_frameSeconds.reserve(script.GetLength());
+    m_workerWaitSeconds.reserve(script.GetLength());
+}
+
+Benchmark::~Benchmark() {}
+
+bool Benchmark::BeginFrame(unsigned int frame) {
+    if (frame >= m_script.GetLength()) {
+        return false;
+    }
+    m_script.PushEvents(frame);
+    return true;
+}
+
+void Benchmark::EndFrame(double seconds, const RenderStats& stats) {
+    m_frameSeconds.push_back(seconds);
+    m_drawCalls.push_back(stats.drawCalls);
+    m_triangles.push_back(stats.triangles);
+}
+
+void Benchmark::EndWorkerWait(double seconds) {
+    m_workerWaitSeconds.push_back(seconds);
+}
+
+// Nearest rank percentile of sorted values
+template <typename T>
+static T percentile(const std::vector<T>& sorted, double percent) {
+    if (sorted.empty()) {
+        return T();
+    }
+    std::size_t rank = (std::size_t) (percent / 100.0 * sorted.size() + 0.999999);
+    return sorted[std::min(std::max<std::size_t>(rank, 1), sorted.size()) - 1];
+}
+
+// Mean, percentiles and max of values scaled by scale
+template <typename T>
+static void writeDistribution(std::ostream& output, std::vector<T> values, double scale) {
+    std::sort(values.begin(), values.end());
+    double mean = values.empty() ? 0.0 : std::accumulate(values.begin(), values.end(), 0.0) / values.size();
+    output << "{\"mean\": " << mean * scale
+        << ", \"min\": " << (values.empty() ? 0.0 : values.front() * scale)
+        << ", \"p50\": " << percentile(values, 50.0) * scale
+        << ", \"p95\": " << percentile(values, 95.0) * scale
+        << ", \"p99\": " << percentile(values, 99.0) * scale
+        << ", \"max\": " << (values.empty() ? 0.0 : values.back() * scale) << "}";
+}
+
+// 0 where the platform does not report it
+static std::size_t peakResidentBytes() {
+#if defined(_WIN32)
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#if defined(__APPLE__)
+    return usage.ru_maxrss;
+#else
+    // Kilobytes on Linux
+    return (std::size_t) usage.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+void Benchmark::Report(const std::string& renderer, unsigned int threads, const BenchmarkMemory& memory) {
+    std::size_t peak = peakResidentBytes();
+    double seconds = std::accumulate(m_frameSeconds.begin(), m_frameSeconds.end(), 0.0);
+    std::ostringstream output;
+    output << "{" << std::endl;
+    output << "  \"renderer\": \"";
+    for (char c : renderer) {
+        if (c == '"' || c == '\\') {
+            output << '\\';
+        }
+        output << c;
+    }
+    output << "\"," << std::endl;
+    output << "  \"threads\": " << threads << "," << std::endl;
+    output << "  \"frames\": " << m_frameSeconds.size() << "," << std::endl;
+    output << "  \"seconds\": " << seconds << "," << std::endl;
+    output << "  \"framesPerSecond\": " << (seconds > 0.0 ? m_frameSeconds.size() / seconds : 0.0) << "," << std::endl;
+    output << "  \"frameTimeMs\": ";
+    writeDistribution(output, m_frameSeconds, 1000.0);
+    output << "," << std::endl << "  \"workerWaitMs\": ";
+    writeDistribution(output, m_workerWaitSeconds, 1000.0);
+    output << "," << std::endl << "  \"drawCalls\": ";
+    writeDistribution(output, m_drawCalls, 1.0);
+    output << "," << std::endl << "  \"triangles\": ";
+    writeDistribution(output, m_triangles, 1.0);
+    output << "," << std::endl;
+    output << "  \"memory\": {\"worldBytes\": " << memory.worldBytes
+        << ", \"meshBytes\": " << memory.meshBytes
+        << ", \"peakResidentBytes\": " << peak << "}" << std::endl;
+    output << "}" << std::endl;
+    std::cout << output.str();
+    if (!m_reportPath.empty()) {
+        std::ofstream report(m_reportPath.c_str());
+        report << output.str();
+        report.close();
+        if (!report) {
+            std::cout << "Could not write benchmark report " << m_reportPath << std::endl;
+        }
+    }
+}
@@ -1,8 +1,13 @@
+#include <algorithm>
+#include <utility>
+
 #include "BlockBuilder.hpp"
 #include "Camera.hpp"
+#include "CameraUniforms.hpp"
 #include "Error.hpp"
+#include "Profiler.hpp"
 
-// Generate textures coordinates for all block types and store in shared buffer
+// Record the atlas tiles of all block types
 BlockBuilder::BlockBuilder() {
     generateBlockTexture(Dirt, 242, 242, 242);
     generateBlockTexture(Grass, 240, 243, 242);
@@ -15,6 +20,14 @@ BlockBuilder::BlockBuilder() {
     generateBlockTexture(OrangeWool, 34, 34, 34);
     generateBlockTexture(Snow, 178, 180, 180);
 	lightingEnabled = 0;
+	m_renderMode = ChunkMeshRender;
+	m_instancesDirty = true;
+	m_renderStats = {0, 0, 0, 0, 0};
+	m_jobs = nullptr;
+	m_meshGeneration = 1;
+	m_meshTicket = 0;
+	m_pendingMeshes = 0;
+	m_reportMeshBatch = true;
 }
 
 BlockBuilder::~BlockBuilder() {}
@@ -42,17 +55,17 @@ FaceTexture BlockBuilder::generateFaceTexture(int faceAtlasIndex) {
     return (FaceTexture) {leftU, rightU, topV, bottomV};
 }
 
-// Generate texture coordinates for the three face textures of a block and add to texture buffer
+// Record the atlas tiles of the three face textures of a block
+// The shaders turn these into texture coordinates
 void BlockBuilder::generateBlockTexture(BlockType blockType, int topAtlasIndex, int sideAtlasIndex, int bottomAtlasIndex) {
-    FaceTexture topFace = generateFaceTexture(topAtlasIndex);
-    FaceTexture sideFace = generateFaceTexture(sideAtlasIndex);
-    FaceTexture bottomFace = generateFaceTexture(bottomAtlasIndex);
-    sideFace.addToBuffer(m_blockTextures);     // Front face
-    sideFace.addToBuffer(m_blockTextures);     // Back face
-    topFace.addToBuffer(m_blockTextures);      // Top face
-    bottomFace.addToBuffer(m_blockTextures);   // Bottom face
-    sideFace.addToBuffer(m_blockTextures);     // Right face
-    sideFace.addToBuffer(m_blockTextures);     // Left face
+    m_blockAtlasIndices.insert(m_blockAtlasIndices.end(), {
+        sideAtlasIndex,     // Front face
+        sideAtlasIndex,     // Back face
+        topAtlasIndex,      // Top face
+        bottomAtlasIndex,   // Bottom face
+        sideAtlasIndex,     // Right face
+        sideAtlasIndex      // Left face
+    });
 }
 
 // Initialization of BlockBuilder
@@ -108,12 +121,22 @@ void BlockBuilder::InitializeBlockData(std::string atlasFileName) {
 		20, 21, 22, 20, 22, 23  // Left face
 	};
 
+	// The mesher builds chunk geometry from the same faces and atlas tiles
+	m_mesher.Initialize(m_vertices, m_blockAtlasIndices);
+
+	// Every face covers one whole atlas tile, the shader moves
+	// these coordinates to the tile of the block type being drawn
+	FaceTexture unitTile = {0.0f, 1.0f, 1.0f, 0.0f};
+	for (int face = 0; face < NumFaces; face++) {
+		unitTile.addToBuffer(m_faceTexCoords);
+	}
+
 	// Create a buffer and set the stride of information
 	// Buffer 1 - positions and normals
 	// Buffer 2 - texture coordinates
 	m_vertexBufferLayout.CreateTextureBufferLayout(
-        m_vertices.size(), m_blockTextures.size(), m_indices.size(),
-        m_vertices.data(), m_blockTextures.data(), m_indices.data()
+        m_vertices.size(), m_faceTexCoords.size(), m_indices.size(),
+        m_vertices.data(), m_faceTexCoords.data(), m_indices.data()
     );
 
 	// Load our actual texture
@@ -121,62 +144,275 @@ void BlockBuilder::InitializeBlockData(std::string atlasFileName) {
 	m_texture.LoadTexture(atlasFileName.c_str());
 
 	// Setup shaders
+	loadShaders();
+
+    m_vertexBufferLayout.Bind();
+	m_texture.Bind();
+}
+
+// Compile the per block and chunk mesh shaders
+// Both share frag.glsl, chunk meshes unpack their vertices in chunk_vert.glsl
+void BlockBuilder::loadShaders() {
 	std::string vertexShader = m_shader.LoadShader("./shaders/vert.glsl");
+	std::string chunkVertexShader = m_chunkShader.LoadShader("./shaders/chunk_vert.glsl");
 	std::string fragmentShader = m_shader.LoadShader("./shaders/frag.glsl");
 
-    // Actually create our shader
+    // Actually create our shaders
 	m_shader.CreateShader(vertexShader, fragmentShader);
+	m_chunkShader.CreateShader(chunkVertexShader, fragmentShader);
+	m_shader.BindUniformBlock("CameraUniforms", CAMERA_UNIFORM_BINDING);
+	m_chunkShader.BindUniformBlock("CameraUniforms", CAMERA_UNIFORM_BINDING);
 
-    m_vertexBufferLayout.Bind();
-	m_texture.Bind();
-	m_shader.Bind();
+	// Size of an atlas tile without the inset on both sides
+	FaceTexture tile = generateFaceTexture(0);
+	float atlasTileSize = tile.rightU - tile.leftU;
+
+	// Pack the six 8 bit tiles of each block type into a uvec2,
+	// faces 0-3 in x and faces 4-5 in y
+	static_assert(Empty <= 64, "vert.glsl holds the tiles of at most MAX_BLOCK_TYPES block types");
+	std::vector<GLuint> blockTiles(2 * (m_blockAtlasIndices.size() / NumFaces), 0);
+	for (unsigned int i = 0; i < m_blockAtlasIndices.size(); i++) {
+		int blockType = i / NumFaces;
+		int face = i % NumFaces;
+		blockTiles[blockType*2 + face/4] |= (GLuint) m_blockAtlasIndices[i] << (8 * (face % 4));
+	}
 
+	m_shader.Bind();
     m_shader.SetUniformMatrix1i("u_Texture", 0);
+    m_shader.SetUniform1f("atlasTileSize", atlasTileSize);
+    m_shader.SetUniform2uiv("blockTiles", blockTiles.size() / 2, blockTiles.data());
+	m_chunkShader.Bind();
+    m_chunkShader.SetUniformMatrix1i("u_Texture", 0);
+    m_chunkShader.SetUniform1f("atlasTileSize", atlasTileSize);
 }
 
-void BlockBuilder::Update(BlockData& blockData, unsigned int screenWidth, unsigned int screenHeight) {
-    // Here we apply the 'view' matrix which creates perspective.
-	// The first argument is 'field of view'
-	// Then perspective
-	// Then the near and far clipping plane.
-	// Note I cannot see anything closer than 0.1f units from the screen.
-	m_projectionMatrix = glm::perspective(45.0f, (float)screenWidth/(float)screenHeight, 0.1f, 150.0f);
-	// Set the uniforms in our current shader
-	m_shader.SetUniformMatrix4fv("model", blockData.m_transform.GetTransformMatrix());
-    m_shader.SetUniformMatrix4fv("view", &Camera::Instance().GetWorldToViewmatrix()[0][0]);
-	m_shader.SetUniformMatrix4fv("projection", &m_projectionMatrix[0][0]);
+// Shader used by the current render mode
+Shader& BlockBuilder::currentShader() {
+	return m_renderMode == ChunkMeshRender ? m_chunkShader : m_shader;
+}
+
+// Offset of the geometry drawn next, in world coordinates
+// View and projection are set once per frame in the CameraUniforms buffer
+void BlockBuilder::Update(int x, int y, int z) {
+	currentShader().SetUniform3f("blockOffset", x, y, z);
 }
 
 void BlockBuilder::Render(BlocksArray& blocksArray) {
-	// Select this BlockBuilders buffer to render
-	m_vertexBufferLayout.Bind();
+	PROFILE_SCOPE("BlockBuilder::Render");
 	// Select this BlockBuilders texture to render
 	m_texture.Bind();
 	// Select this BlockBuilders shader to render
-	m_shader.Bind();
+	Shader& shader = currentShader();
+	shader.Bind();
 	// Set uniforms for directional light
-	m_shader.SetUniformMatrix1i("lightingEnabled", lightingEnabled);
-    m_shader.SetUniform3f("lights[0].lightColor", 1.0f, 1.0f, 1.0f);
-    m_shader.SetUniform3f("lights[0].lightDir", -0.5f, -1.0f, -0.5f);
-    m_shader.SetUniform1f("lights[0].ambientIntensity", 0.4f);
-    m_shader.SetUniform1f("lights[0].specularStrength", 0.3f);
+	shader.SetUniformMatrix1i("lightingEnabled", lightingEnabled);
+    shader.SetUniform3f("lights[0].lightColor", 1.0f, 1.0f, 1.0f);
+    shader.SetUniform3f("lights[0].lightDir", -0.5f, -1.0f, -0.5f);
+    shader.SetUniform1f("lights[0].ambientIntensity", 0.4f);
+    shader.SetUniform1f("lights[0].specularStrength", 0.3f);
+    m_renderStats = {0, 0, 0, 0, 0};
+    collectDirtyChunks(blocksArray);
     // Render data
-    for (int x = 0; x < WIDTH; x++) {
-        for (int y = 0; y < HEIGHT; y++) {
-            for (int z = 0; z < DEPTH; z++) {
-                BlockData block = blocksArray.getBlock(x, y, z);
-                if (block.isVisible) {
-					// Set texture offset in texture buffer based on block type
-                    glVertexAttribPointer(2, 2, GL_FLOAT, GL_TRUE, sizeof(float)*2, (GLvoid*)(48 * block.blockType * sizeof(GLfloat)));
-                    Update(block, 1280, 720); // Apply transforms for each block
-                    glDrawElements(GL_TRIANGLES,
-                        m_indices.size(),   // The number of indices, not triangles.
-                        GL_UNSIGNED_INT,    // Make sure the data type matches
-                        nullptr);           // Offset pointer to the data. nullptr
-                                            // because we are currently bound:
+    if (m_renderMode == ChunkMeshRender) {
+        renderChunkMeshes(blocksArray);
+    }
+    else {
+        renderBlocks(blocksArray);
+    }
+}
+
+// Returns true if the chunk is at least partly inside the view frustum
+// Counts the test in the render stats
+bool BlockBuilder::chunkInFrustum(const ChunkCoord& coord) {
+    m_renderStats.chunksTested++;
+    // Blocks are centered on their coordinate
+    glm::vec3 chunkMin = glm::vec3(coord.x, coord.y, coord.z) * (float) CHUNK_SIZE - 0.5f;
+    glm::vec3 chunkMax = chunkMin + (float) CHUNK_SIZE;
+    if (!Camera::Instance().IsBoxInFrustum(chunkMin, chunkMax)) {
+        m_renderStats.chunksCulled++;
+        return false;
+    }
+    return true;
+}
+
+// Draw every visible block as an instance of the cube
+// The instance buffer holds x,y,z and block type plus face mask of each
+// visible block, grouped by chunk so chunks outside the frustum can be skipped.
+// It is only rebuilt after the world changes.
+void BlockBuilder::renderBlocks(BlocksArray& blocksArray) {
+	PROFILE_SCOPE("BlockBuilder::renderBlocks");
+	// Select this BlockBuilders buffer to render
+	m_vertexBufferLayout.Bind();
+    if (m_instancesDirty) {
+        PROFILE_SCOPE("BlockBuilder::rebuildInstances");
+        std::vector<GLint> instances;
+        m_chunkInstances.clear();
+        for (auto& entry : blocksArray.chunks) {
+            const ChunkCoord& coord = entry.first;
+            Chunk& chunk = *entry.second;
+            unsigned int first = instances.size() / 4;
+            if (chunk.faceMasks.empty()) {
+                continue;
+            }
+            for (int x = 0; x < CHUNK_SIZE; x++) {
+                for (int y = 0; y < CHUNK_SIZE; y++) {
+                    for (int z = 0; z < CHUNK_SIZE; z++) {
+                        BlockData block = chunk.getBlock(x, y, z);
+                        if (block.faceMask != 0) {
+                            instances.insert(instances.end(), {
+                                coord.x*CHUNK_SIZE + x, coord.y*CHUNK_SIZE + y, coord.z*CHUNK_SIZE + z,
+                                block.blockType | (block.faceMask << 8)
+                            });
+                        }
+                    }
                 }
             }
+            unsigned int count = instances.size() / 4 - first;
+            if (count > 0) {
+                m_chunkInstances.push_back({coord, first, count});
+            }
+        }
+        m_vertexBufferLayout.SetInstanceData(instances.size(), instances.data());
+        m_instancesDirty = false;
+    }
+    // Instances carry their own position
+    Update(0, 0, 0);
+    for (const ChunkInstances& chunkInstances : m_chunkInstances) {
+        if (!chunkInFrustum(chunkInstances.coord)) {
+            continue;
+        }
+        m_vertexBufferLayout.SetFirstInstance(chunkInstances.first);
+        glDrawElementsInstanced(GL_TRIANGLES,
+            m_indices.size(),       // The number of indices, not triangles.
+            GL_UNSIGNED_INT,        // Make sure the data type matches
+            nullptr,                // Offset pointer to the data. nullptr
+                                    // because we are currently bound
+            chunkInstances.count);  // One cube per visible block
+        m_renderStats.chunksDrawn++;
+        m_renderStats.drawCalls++;
+        m_renderStats.triangles += m_indices.size() / 3 * chunkInstances.count;
+    }
+}
+
+// Draw one mesh per chunk, requesting meshes for chunks that have none
+// for the current generation. A chunk keeps drawing its previous mesh
+// until the new one is uploaded, so the frame never waits for meshing.
+void BlockBuilder::renderChunkMeshes(BlocksArray& blocksArray) {
+    PROFILE_SCOPE("BlockBuilder::renderChunkMeshes");
+    uploadFinishedMeshes();
+    unsigned int budget = MESH_REQUESTS_PER_FRAME;
+    // Edited chunks go first so building shows up within a frame or two
+    while (budget > 0 && !m_remeshQueue.empty()) {
+        ChunkCoord coord = m_remeshQueue.front();
+        m_remeshQueue.pop_front();
+        // Unloaded chunks are skipped without creating a state for them
+        auto it = m_chunkStates.find(coord);
+        const Chunk* chunk = blocksArray.findChunk(coord);
+        if (chunk != nullptr && it != m_chunkStates.end() && it->second.generation != m_meshGeneration) {
+            requestMesh(coord, *chunk, it->second);
+            budget--;
+        }
+    }
+    // Out of date chunks in view, meshed nearest first once drawing is done
+    std::vector<StaleChunk> staleChunks;
+    for (auto& entry : blocksArray.chunks) {
+        const ChunkCoord& coord = entry.first;
+        // Chunks out of view are neither meshed nor drawn
+        if (!chunkInFrustum(coord)) {
+            continue;
+        }
+        ChunkRenderState& state = m_chunkStates[coord];
+        if (state.generation != m_meshGeneration && budget > 0) {
+            staleChunks.push_back({chunkDistance(coord), coord, entry.second.get(), &state});
+        }
+        if (!state.mesh || state.mesh->indexCount == 0) {
+            continue;
+        }
+        state.mesh->layout.Bind();
+        // Mesh vertices are relative to the chunk origin
+        Update(coord.x*CHUNK_SIZE, coord.y*CHUNK_SIZE, coord.z*CHUNK_SIZE);
+        glDrawElements(GL_TRIANGLES, state.mesh->indexCount, GL_UNSIGNED_INT, nullptr);
+        m_renderStats.chunksDrawn++;
+        m_renderStats.drawCalls++;
+        m_renderStats.triangles += state.mesh->indexCount / 3;
+    }
+    unsigned int count = std::min(budget, (unsigned int) staleChunks.size());
+    std::partial_sort(staleChunks.begin(), staleChunks.begin() + count, staleChunks.end(),
+        [](const StaleChunk& a, const StaleChunk& b) {
+            return a.distance < b.distance;
+        });
+    for (unsigned int i = 0; i < count; i++) {
+        requestMesh(staleChunks[i].coord, *staleChunks[i].chunk, *staleChunks[i].state);
+    }
+}
+
+// Squared distance from the eye to the center of a chunk
+float BlockBuilder::chunkDistance(const ChunkCoord& coord) {
+    Camera& camera = Camera::Instance();
+    float dx = coord.x*CHUNK_SIZE + CHUNK_SIZE / 2 - camera.GetEyeXPosition();
+    float dy = coord.y*CHUNK_SIZE + CHUNK_SIZE / 2 - camera.GetEyeYPosition();
+    float dz = coord.z*CHUNK_SIZE + CHUNK_SIZE / 2 - camera.GetEyeZPosition();
+    return dx*dx + dy*dy + dz*dz;
+}
+
+// Queue a mesh build of the chunk for the current generation
+// Workers mesh a copy of the chunk, so the world can change while they run.
+void BlockBuilder::requestMesh(const ChunkCoord& coord, const Chunk& chunk, ChunkRenderState& state) {
+    PROFILE_SCOPE("BlockBuilder::requestMesh");
+    state.generation = m_meshGeneration;
+    state.ticket = ++m_meshTicket;
+    if (m_pendingMeshes == 0) {
+        m_meshBatch = MeshBatchStats();
+        m_meshBatch.start = std::chrono::steady_clock::now();
+    }
+    m_pendingMeshes++;
+    std::shared_ptr<Chunk> chunkCopy = std::make_shared<Chunk>(chunk);
+    unsigned int ticket = state.ticket;
+    MeshingMode mode = m_mesher.GetMode();
+    std::function<void()> job = [this, coord, ticket, mode, chunkCopy]() {
+        std::unique_ptr<MeshResult> result(new MeshResult());
+        result->coord = coord;
+        result->ticket = ticket;
+        m_mesher.Mesh(*chunkCopy, mode, result->mesh);
+        m_finishedMeshes.Push(std::move(result));
+    };
+    if (m_jobs != nullptr) {
+        m_jobs->Submit(std::move(job));
+    }
+    else {
+        job();
+    }
+}
+
+// Upload the meshes workers finished since the last frame
+// Only the result of a chunk's last request is used, older ones are dropped.
+void BlockBuilder::uploadFinishedMeshes() {
+    PROFILE_SCOPE("BlockBuilder::uploadFinishedMeshes");
+    std::vector<std::unique_ptr<MeshResult>> results;
+    m_finishedMeshes.PopAll(results);
+    for (std::unique_ptr<MeshResult>& result : results) {
+        m_pendingMeshes--;
+        auto it = m_chunkStates.find(result->coord);
+        if (it == m_chunkStates.end() || it->second.ticket != result->ticket) {
+            continue;
         }
+        ChunkRenderState& state = it->second;
+        if (!state.mesh) {
+            state.mesh.reset(new ChunkMesh());
+        }
+        state.mesh->Upload(result->mesh);
+        m_meshBatch.chunks++;
+        m_meshBatch.vertices += state.mesh->vertexCount;
+        m_meshBatch.indices += state.mesh->indexCount;
+    }
+    if (!results.empty() && m_pendingMeshes == 0 && m_meshBatch.chunks > 0 && m_reportMeshBatch) {
+        m_reportMeshBatch = false;
+        double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_meshBatch.start).count();
+        std::cout << "Meshed " << m_meshBatch.chunks << " chunks ("
+            << (m_mesher.GetMode() == GreedyMeshing ? "greedy" : "culled") << ") in "
+            << milliseconds << " ms on " << (m_jobs != nullptr ? m_jobs->GetWorkerCount() : 0) << " workers: "
+            << m_meshBatch.vertices << " vertices, " << m_meshBatch.indices / 3 << " triangles, "
+            << m_meshBatch.vertices / m_meshBatch.chunks << " vertices per chunk" << std::endl;
     }
 }
 
@@ -193,7 +429,91 @@ void BlockBuilder::ToggleLighting() {
 
 // Reload shader while program is running for debugging
 void BlockBuilder::ReloadShaders() {
-	std::string vertexShader = m_shader.LoadShader("./shaders/vert.glsl");
-	std::string fragmentShader = m_shader.LoadShader("./shaders/frag.glsl");
-	m_shader.CreateShader(vertexShader, fragmentShader);
+	loadShaders();
+}
+
+// Cycle between culled chunk meshes, greedy chunk meshes and per block rendering
+void BlockBuilder::ToggleRenderMode() {
+	if (m_renderMode == PerBlockRender) {
+		m_renderMode = ChunkMeshRender;
+		m_mesher.SetMode(CulledMeshing);
+		std::cout << "Render mode: culled chunk mesh" << std::endl;
+	}
+	else if (m_mesher.GetMode() == CulledMeshing) {
+		m_mesher.SetMode(GreedyMeshing);
+		std::cout << "Render mode: greedy chunk mesh" << std::endl;
+	}
+	else {
+		m_renderMode = PerBlockRender;
+		std::cout << "Render mode: per block" << std::endl;
+	}
+	// Meshes of the previous mode no longer apply
+	InvalidateMeshes();
+	m_reportMeshBatch = true;
+}
+
+// Mark the chunks edited since the last frame as out of date
+// Edits are coalesced by the dirty set, so each chunk is remeshed once
+// no matter how many of its blocks changed. Queued nearest first.
+// The meshes of unloaded chunks are released.
+void BlockBuilder::collectDirtyChunks(BlocksArray& blocksArray) {
+	if (blocksArray.dirtyChunks.empty() && blocksArray.removedChunks.empty()) {
+		return;
+	}
+	PROFILE_SCOPE("BlockBuilder::collectDirtyChunks");
+	for (const ChunkCoord& coord : blocksArray.removedChunks) {
+		m_chunkStates.erase(coord);
+	}
+	blocksArray.removedChunks.clear();
+	std::vector<std::pair<float, ChunkCoord>> remesh;
+	for (const ChunkCoord& coord : blocksArray.dirtyChunks) {
+		auto it = m_chunkStates.find(coord);
+		// Chunks never meshed are picked up when they come into view
+		if (it != m_chunkStates.end() && it->second.generation != 0) {
+			it->second.generation = 0;
+			remesh.push_back(std::make_pair(chunkDistance(coord), coord));
+		}
+	}
+	std::sort(remesh.begin(), remesh.end(),
+		[](const std::pair<float, ChunkCoord>& a, const std::pair<float, ChunkCoord>& b) {
+			return a.first < b.first;
+		});
+	for (const std::pair<float, ChunkCoord>& entry : remesh) {
+		m_remeshQueue.push_back(entry.second);
+	}
+	blocksArray.dirtyChunks.clear();
+	m_instancesDirty = true;
+}
+
+// Rebuild chunk meshes and block instances from the world
+// Chunk meshes are only replaced once their new version is uploaded
+void BlockBuilder::InvalidateMeshes() {
+	m_meshGeneration++;
+	m_instancesDirty = true;
+}
+
+// Run chunk meshing on the workers of jobs instead of the render thread
+void BlockBuilder::SetJobSystem(JobSystem* jobs) {
+	m_jobs = jobs;
+}
+
+// Chunk culling counters of the last frame
+const RenderStats& BlockBuilder::GetRenderStats() const {
+	return m_renderStats;
+}
+
+// Instances are x,y,z and type of each visible block, mesh vertices
+// CHUNK_VERTEX_WORDS words each
+std::size_t BlockBuilder::GetMeshMemory() const {
+    std::size_t bytes = 0;
+    for (const ChunkInstances& chunkInstances : m_chunkInstances) {
+        bytes += chunkInstances.count * 4 * sizeof(GLint);
+    }
+    for (const auto& entry : m_chunkStates) {
+        if (entry.second.mesh) {
+            bytes += entry.second.mesh->vertexCount * CHUNK_VERTEX_WORDS * sizeof(GLuint) +
+                entry.second.mesh->indexCount * sizeof(GLuint);
+        }
+    }
+    return bytes;
 }
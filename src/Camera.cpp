@@ -1,8 +1,10 @@
 #include "Camera.hpp"
+#include "Profiler.hpp"
 
 #include "glm/gtx/transform.hpp"
 #include "glm/gtx/rotate_vector.hpp"
 
+#include <cmath>
 #include <iostream>
 
 Camera& Camera::Instance() {
@@ -11,6 +13,7 @@ Camera& Camera::Instance() {
 }
 
 void Camera::MouseLook(int mouseX, int mouseY) {
+    PROFILE_SCOPE("Camera::MouseLook");
     float sensitivity = 0.5f;
     float xDelta = (mouseX - m_oldMousePosition.x) * sensitivity;
     float yDelta = (m_oldMousePosition.y - mouseY) * sensitivity;
@@ -48,11 +51,13 @@ void Camera::MouseLook(int mouseX, int mouseY) {
 }
 
 bool Camera::CollisionAt(glm::vec3 position, BlocksArray& blocksArray) {
-    int x = position.x;
-    int y = position.y;
-    int z = position.z;
+    PROFILE_SCOPE("Camera::CollisionAt");
+    // Blocks are centered on their coordinate, round to the nearest one
+    int x = (int) std::floor(position.x + 0.5f);
+    int y = (int) std::floor(position.y + 0.5f);
+    int z = (int) std::floor(position.z + 0.5f);
     if (collisionEnabled) {
-        return blocksArray.isValidBlock(x, y, z) && blocksArray.getBlock(x, y, z).isVisible;
+        return blocksArray.isVisibleBlock(x, y, z);
     }
     return false;
 }
@@ -111,6 +116,11 @@ float Camera::GetEyeZPosition() {
     return m_eyePosition.z;
 }
 
+// Place the camera without checking for collisions
+void Camera::SetEyePosition(const glm::vec3& position) {
+    m_eyePosition = position;
+}
+
 float Camera::GetViewXDirection() {
     return m_viewDirection.x;
 }
@@ -141,6 +151,47 @@ Camera::Camera() {
     collisionEnabled = true;
 }
 
+void Camera::SetProjection(float fieldOfView, float aspectRatio, float nearPlane, float farPlane) {
+    m_projectionMatrix = glm::perspective(fieldOfView, aspectRatio, nearPlane, farPlane);
+}
+
+const glm::mat4& Camera::GetProjectionMatrix() const {
+    return m_projectionMatrix;
+}
+
+// Extract the planes from the rows of projection * view
+// (Gribb and Hartmann, "Fast Extraction of Viewing Frustum Planes")
+void Camera::UpdateFrustum() {
+    PROFILE_SCOPE("Camera::UpdateFrustum");
+    glm::mat4 clip = m_projectionMatrix * GetWorldToViewmatrix();
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++) {
+        rows[i] = glm::vec4(clip[0][i], clip[1][i], clip[2][i], clip[3][i]);
+    }
+    m_frustumPlanes[0] = rows[3] + rows[0];
+    m_frustumPlanes[1] = rows[3] - rows[0];
+    m_frustumPlanes[2] = rows[3] + rows[1];
+    m_frustumPlanes[3] = rows[3] - rows[1];
+    m_frustumPlanes[4] = rows[3] + rows[2];
+    m_frustumPlanes[5] = rows[3] - rows[2];
+}
+
+bool Camera::IsBoxInFrustum(const glm::vec3& boxMin, const glm::vec3& boxMax) const {
+    for (int i = 0; i < 6; i++) {
+        const glm::vec4& plane = m_frustumPlanes[i];
+        // Corner of the box furthest along the plane normal
+        glm::vec3 corner(
+            plane.x >= 0.0f ? boxMax.x : boxMin.x,
+            plane.y >= 0.0f ? boxMax.y : boxMin.y,
+            plane.z >= 0.0f ? boxMax.z : boxMin.z
+        );
+        if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
+
 glm::mat4 Camera::GetWorldToViewmatrix() const{
     // Think about the second argument and why that is
     // setup as it is.
@@ -0,0 +1,26 @@
+#include "CameraUniforms.hpp"
+
+#include "glm/gtc/type_ptr.hpp"
+
+CameraUniforms::CameraUniforms() {}
+
+CameraUniforms::~CameraUniforms() {
+    glDeleteBuffers(1, &m_buffer);
+}
+
+void CameraUniforms::Create() {
+    glGenBuffers(1, &m_buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+    // std140 layout: view followed by projection
+    glBufferData(GL_UNIFORM_BUFFER, 2 * sizeof(glm::mat4), nullptr, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, CAMERA_UNIFORM_BINDING, m_buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void CameraUniforms::Update(const Camera& camera) {
+    glm::mat4 view = camera.GetWorldToViewmatrix();
+    glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4), glm::value_ptr(view));
+    glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), sizeof(glm::mat4), glm::value_ptr(camera.GetProjectionMatrix()));
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
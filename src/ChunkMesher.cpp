@@ -0,0 +1,190 @@
+#include "ChunkMesher.hpp"
+#include "Profiler.hpp"
+
+// Replace the buffer contents with new geometry
+void ChunkMesh::Upload(const MeshData& mesh) {
+    layout.CreateChunkBufferLayout(
+        mesh.vertices.size(), mesh.indices.size(),
+        mesh.vertices.data(), mesh.indices.data()
+    );
+    indexCount = mesh.indices.size();
+    vertexCount = mesh.vertices.size() / CHUNK_VERTEX_WORDS;
+}
+
+ChunkMesher::ChunkMesher() {
+    m_mode = CulledMeshing;
+}
+
+ChunkMesher::~ChunkMesher() {}
+
+// Copy the face geometry and texture coordinates used to build meshes
+void ChunkMesher::Initialize(const std::vector<GLfloat>& cubeVertices, const std::vector<int>& blockAtlasIndices) {
+    m_cubeVertices = cubeVertices;
+    m_blockAtlasIndices = blockAtlasIndices;
+    // The first vertex of a face has texture coordinate (0, 0),
+    // the second (1, 0) and the fourth (0, 1)
+    for (int face = 0; face < NumFaces; face++) {
+        const GLfloat* v0 = &m_cubeVertices[(face*4 + 0) * 6];
+        const GLfloat* v1 = &m_cubeVertices[(face*4 + 1) * 6];
+        const GLfloat* v3 = &m_cubeVertices[(face*4 + 3) * 6];
+        for (int k = 0; k < 3; k++) {
+            m_faceAxes[face][0][k] = (int) (v1[k] - v0[k]);
+            m_faceAxes[face][1][k] = (int) (v3[k] - v0[k]);
+        }
+    }
+}
+
+void ChunkMesher::SetMode(MeshingMode mode) {
+    m_mode = mode;
+}
+
+MeshingMode ChunkMesher::GetMode() const {
+    return m_mode;
+}
+
+// Append a quad covering size[] blocks starting at local block base[]
+// The cube face is stretched so each of its corners lands on the far
+// side of the covered area, and s,t count blocks from the first corner.
+void ChunkMesher::addQuad(MeshData& out, int face, int blockType, const int base[3], const int size[3]) const {
+    GLuint first = out.vertices.size() / CHUNK_VERTEX_WORDS;
+    GLuint tile = m_blockAtlasIndices[blockType*NumFaces + face];
+    int corner[3];
+    for (int v = 0; v < 4; v++) {
+        const GLfloat* vertex = &m_cubeVertices[(face*4 + v) * 6];
+        // Corners are stored shifted by half a block so they are never negative
+        int position[3];
+        for (int k = 0; k < 3; k++) {
+            position[k] = base[k] + (vertex[k] > 0.0f ? size[k] : 0);
+        }
+        if (v == 0) {
+            corner[0] = position[0];
+            corner[1] = position[1];
+            corner[2] = position[2];
+        }
+        int s = 0;
+        int t = 0;
+        for (int k = 0; k < 3; k++) {
+            s += (position[k] - corner[k]) * m_faceAxes[face][0][k];
+            t += (position[k] - corner[k]) * m_faceAxes[face][1][k];
+        }
+        out.vertices.push_back(
+            position[0] | (position[1] << 5) | (position[2] << 10) |
+            (face << 15) | (s << 18) | (t << 23)
+        );
+        out.vertices.push_back(tile);
+    }
+    out.indices.insert(out.indices.end(), {first, first + 1, first + 2, first, first + 2, first + 3});
+}
+
+// Build the mesh of a chunk
+// Only reads the chunk and data fixed by Initialize, so workers can
+// mesh different chunks in parallel.
+void ChunkMesher::Mesh(const Chunk& chunk, MeshingMode mode, MeshData& out) const {
+    PROFILE_SCOPE("ChunkMesher::Mesh");
+    out.vertices.clear();
+    out.indices.clear();
+    if (mode == GreedyMeshing) {
+        meshGreedy(chunk, out);
+    }
+    else {
+        meshCulled(chunk, out);
+    }
+}
+
+// Emit one quad per exposed face
+void ChunkMesher::meshCulled(const Chunk& chunk, MeshData& out) const {
+    const int size[3] = {1, 1, 1};
+    if (chunk.faceMasks.empty()) {
+        return;
+    }
+    for (int x = 0; x < CHUNK_SIZE; x++) {
+        for (int y = 0; y < CHUNK_SIZE; y++) {
+            for (int z = 0; z < CHUNK_SIZE; z++) {
+                BlockData block = chunk.getBlock(x, y, z);
+                if (block.faceMask == 0) {
+                    continue;
+                }
+                for (int face = 0; face < NumFaces; face++) {
+                    if ((block.faceMask >> face) & 1) {
+                        const int base[3] = {x, y, z};
+                        addQuad(out, face, block.blockType, base, size);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Merge exposed faces slice by slice into the largest rectangles possible
+// For every face direction and every slice of the chunk along its normal,
+// a 2D mask records the block type of each exposed face. Rectangles of
+// equal type are then grown first along the a axis and then along b.
+void ChunkMesher::meshGreedy(const Chunk& chunk, MeshData& out) const {
+    int mask[CHUNK_SIZE * CHUNK_SIZE];
+    if (chunk.faceMasks.empty()) {
+        return;
+    }
+    for (int face = 0; face < NumFaces; face++) {
+        // Axis along the face normal and the two axes in its plane
+        int n = FACE_NORMALS[face][0] != 0 ? 0 : (FACE_NORMALS[face][1] != 0 ? 1 : 2);
+        int a = (n + 1) % 3;
+        int b = (n + 2) % 3;
+        for (int d = 0; d < CHUNK_SIZE; d++) {
+            int position[3];
+            position[n] = d;
+            for (int j = 0; j < CHUNK_SIZE; j++) {
+                for (int i = 0; i < CHUNK_SIZE; i++) {
+                    position[a] = i;
+                    position[b] = j;
+                    BlockData block = chunk.getBlock(position[0], position[1], position[2]);
+                    mask[i + j*CHUNK_SIZE] = ((block.faceMask >> face) & 1) ? (int) block.blockType : (int) Empty;
+                }
+            }
+
+            for (int j = 0; j < CHUNK_SIZE; j++) {
+                for (int i = 0; i < CHUNK_SIZE; ) {
+                    int blockType = mask[i + j*CHUNK_SIZE];
+                    if (blockType == Empty) {
+                        i++;
+                        continue;
+                    }
+                    int width = 1;
+                    while (i + width < CHUNK_SIZE && mask[i + width + j*CHUNK_SIZE] == blockType) {
+                        width++;
+                    }
+                    int height = 1;
+                    bool rowMatches = true;
+                    while (j + height < CHUNK_SIZE && rowMatches) {
+                        for (int k = 0; k < width; k++) {
+                            if (mask[i + k + (j + height)*CHUNK_SIZE] != blockType) {
+                                rowMatches = false;
+                                break;
+                            }
+                        }
+                        if (rowMatches) {
+                            height++;
+                        }
+                    }
+
+                    int base[3];
+                    base[n] = d;
+                    base[a] = i;
+                    base[b] = j;
+                    int size[3];
+                    size[n] = 1;
+                    size[a] = width;
+                    size[b] = height;
+                    addQuad(out, face, blockType, base, size);
+
+                    // Clear the covered faces so they are not emitted again
+                    for (int h = 0; h < height; h++) {
+                        for (int k = 0; k < width; k++) {
+                            mask[i + k + (j + h)*CHUNK_SIZE] = Empty;
+                        }
+                    }
+                    i += width;
+                }
+            }
+        }
+    }
+}
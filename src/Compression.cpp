@@ -0,0 +1,253 @@
+#include "Compression.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+static uint32_t read32(const uint8_t* p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+// Write a length beyond the 15 held by a token nibble
+static void writeLength(std::vector<uint8_t>& out, std::size_t length) {
+    while (length >= 255) {
+        out.push_back(255);
+        length -= 255;
+    }
+    out.push_back((uint8_t) length);
+}
+
+// Read a length continued past a token nibble of 15
+static bool readLength(const uint8_t* src, std::size_t size, std::size_t& in, std::size_t& length) {
+    uint8_t byte;
+    do {
+        if (in >= size) {
+            return false;
+        }
+        byte = src[in++];
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+// Append a sequence, matchLength 0 for the final literals only sequence
+static void writeSequence(std::vector<uint8_t>& out, const uint8_t* literals, std::size_t literalLength,
+                          std::size_t offset, std::size_t matchLength) {
+    std::size_t matchCode = matchLength > 0 ? matchLength - LZ4_MIN_MATCH : 0;
+    out.push_back((uint8_t) ((literalLength < 15 ? literalLength : 15) << 4 | (matchCode < 15 ? matchCode : 15)));
+    if (literalLength >= 15) {
+        writeLength(out, literalLength - 15);
+    }
+    out.insert(out.end(), literals, literals + literalLength);
+    if (matchLength == 0) {
+        return;
+    }
+    out.push_back((uint8_t) (offset & 0xff));
+    out.push_back((uint8_t) (offset >> 8));
+    if (matchCode >= 15) {
+        writeLength(out, matchCode - 15);
+    }
+}
+
+// Greedy compression with a hash table of the last position of every
+// 4 byte sequence. Runs without matches are skipped over faster the
+// longer they get, so incompressible data costs little time.
+void CompressLZ4(const uint8_t* src, std::size_t size, std::vector<uint8_t>& out) {
+    out.clear();
+    out.reserve(size / 2 + 16);
+    int table[1 << LZ4_HASH_BITS];
+    memset(table, -1, sizeof(table));
+    std::size_t anchor = 0;
+    std::size_t position = 0;
+    while (size > LZ4_MATCH_FIND_LIMIT && position < size - LZ4_MATCH_FIND_LIMIT) {
+        uint32_t sequence = read32(src + position);
+        uint32_t hash = (sequence * 2654435761u) >> (32 - LZ4_HASH_BITS);
+        int candidate = table[hash];
+        table[hash] = (int) position;
+        if (candidate < 0 || position - candidate > LZ4_MAX_OFFSET || read32(src + candidate) != sequence) {
+            position += 1 + ((position - anchor) >> 6);
+            continue;
+        }
+        std::size_t match = candidate;
+        // Take in equal bytes before the match too
+        while (position > anchor && match > 0 && src[position - 1] == src[match - 1]) {
+            position--;
+            match--;
+        }
+        std::size_t length = LZ4_MIN_MATCH;
+        while (position + length < size - LZ4_LAST_LITERALS && src[position + length] == src[match + length]) {
+            length++;
+        }
+        writeSequence(out, src + anchor, position - anchor, position - match, length);
+        position += length;
+        anchor = position;
+    }
+    writeSequence(out, src + anchor, size - anchor, 0, 0);
+}
+
+bool DecompressLZ4(const uint8_t* src, std::size_t size, uint8_t* dst, std::size_t dstSize) {
+    std::size_t in = 0;
+    std::size_t written = 0;
+    while (in < size) {
+        uint8_t token = src[in++];
+        std::size_t literalLength = token >> 4;
+        if (literalLength == 15 && !readLength(src, size, in, literalLength)) {
+            return false;
+        }
+        if (literalLength > size - in || literalLength > dstSize - written) {
+            return false;
+        }
+        memcpy(dst + written, src + in, literalLength);
+        in += literalLength;
+        written += literalLength;
+        if (in == size) {
+            // The last sequence ends after its literals
+            break;
+        }
+        if (size - in < 2) {
+            return false;
+        }
+        std::size_t offset = src[in] | (src[in + 1] << 8);
+        in += 2;
+        if (offset == 0 || offset > written) {
+            return false;
+        }
+        std::size_t matchLength = token & 15;
+        if (matchLength == 15 && !readLength(src, size, in, matchLength)) {
+            return false;
+        }
+        matchLength += LZ4_MIN_MATCH;
+        if (matchLength > dstSize - written) {
+            return false;
+        }
+        // Byte by byte, a match may overlap the bytes it produces
+        const uint8_t* from = dst + written - offset;
+        for (std::size_t i = 0; i < matchLength; i++) {
+            dst[written + i] = from[i];
+        }
+        written += matchLength;
+    }
+    return written == dstSize;
+}
+
+// Bits are packed from the least significant bit of each byte up
+struct BitWriter {
+    std::vector<uint8_t>& out;
+    uint32_t bits;
+    int count;
+
+    void write(uint32_t value, int length) {
+        bits |= value << count;
+        count += length;
+        while (count >= 8) {
+            out.push_back((uint8_t) bits);
+            bits >>= 8;
+            count -= 8;
+        }
+    }
+    // Huffman codes go most significant bit first
+    void writeCode(uint32_t code, int length) {
+        uint32_t reversed = 0;
+        for (int i = 0; i < length; i++) {
+            reversed = (reversed << 1) | ((code >> i) & 1);
+        }
+        write(reversed, length);
+    }
+    void flush() {
+        if (count > 0) {
+            out.push_back((uint8_t) bits);
+        }
+        bits = 0;
+        count = 0;
+    }
+};
+
+// Fixed code of a literal, end of block or length symbol
+static void writeSymbol(BitWriter& writer, unsigned int symbol) {
+    if (symbol < 144) {
+        writer.writeCode(0x30 + symbol, 8);
+    }
+    else if (symbol < 256) {
+        writer.writeCode(0x190 + symbol - 144, 9);
+    }
+    else if (symbol < 280) {
+        writer.writeCode(symbol - 256, 7);
+    }
+    else {
+        writer.writeCode(0xc0 + symbol - 280, 8);
+    }
+}
+
+static const uint16_t LENGTH_BASE[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const uint8_t LENGTH_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const uint16_t DISTANCE_BASE[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const uint8_t DISTANCE_EXTRA[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+static void writeMatch(BitWriter& writer, std::size_t length, std::size_t distance) {
+    int code = 28;
+    while (LENGTH_BASE[code] > length) {
+        code--;
+    }
+    writeSymbol(writer, 257 + code);
+    writer.write(length - LENGTH_BASE[code], LENGTH_EXTRA[code]);
+    code = 29;
+    while (DISTANCE_BASE[code] > distance) {
+        code--;
+    }
+    writer.writeCode(code, 5);
+    writer.write(distance - DISTANCE_BASE[code], DISTANCE_EXTRA[code]);
+}
+
+// Greedy matching with the same hash table as CompressLZ4, but every
+// position is tried since images are mostly matches
+void CompressZlib(const uint8_t* src, std::size_t size, std::vector<uint8_t>& out) {
+    out.clear();
+    out.reserve(size / 4 + 16);
+    // Deflate with a 32 KB window, no preset dictionary
+    out.push_back(0x78);
+    out.push_back(0x01);
+    BitWriter writer = {out, 0, 0};
+    // The only block, final and fixed Huffman coded
+    writer.write(1, 1);
+    writer.write(1, 2);
+    std::vector<int> table(1 << DEFLATE_HASH_BITS, -1);
+    std::size_t position = 0;
+    while (position < size) {
+        if (size - position >= 4) {
+            uint32_t sequence = read32(src + position);
+            uint32_t hash = (sequence * 2654435761u) >> (32 - DEFLATE_HASH_BITS);
+            int candidate = table[hash];
+            table[hash] = (int) position;
+            if (candidate >= 0 && position - candidate <= DEFLATE_MAX_DISTANCE && read32(src + candidate) == sequence) {
+                std::size_t length = 4;
+                std::size_t limit = std::min<std::size_t>(DEFLATE_MAX_MATCH, size - position);
+                while (length < limit && src[position + length] == src[candidate + length]) {
+                    length++;
+                }
+                writeMatch(writer, length, position - candidate);
+                position += length;
+                continue;
+            }
+        }
+        writeSymbol(writer, src[position]);
+        position++;
+    }
+    writeSymbol(writer, 256);
+    writer.flush();
+    // Adler-32 of the uncompressed data, big endian
+    uint32_t a = 1;
+    uint32_t b = 0;
+    for (std::size_t i = 0; i < size; i++) {
+        a = (a + src[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    uint32_t adler = (b << 16) | a;
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        out.push_back((uint8_t) (adler >> shift));
+    }
+}
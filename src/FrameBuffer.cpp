@@ -0,0 +1,56 @@
+#include "FrameBuffer.hpp"
+
+#include <cstring>
+#include <iostream>
+
+FrameBuffer::FrameBuffer() {}
+
+FrameBuffer::~FrameBuffer() {
+    glDeleteFramebuffers(1, &m_framebuffer);
+    glDeleteRenderbuffers(1, &m_color);
+    glDeleteRenderbuffers(1, &m_depth);
+}
+
+bool FrameBuffer::Create(int width, int height) {
+    m_width = width;
+    m_height = height;
+    glGenRenderbuffers(1, &m_color);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_color);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glGenRenderbuffers(1, &m_depth);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    glGenFramebuffers(1, &m_framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_color);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depth);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        std::cout << "Offscreen framebuffer incomplete: " << status << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void FrameBuffer::Bind() {
+    glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+}
+
+void FrameBuffer::Unbind() {
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+// OpenGL returns the bottom row first
+void FrameBuffer::ReadPixels(std::vector<uint8_t>& pixels) {
+    std::size_t stride = (std::size_t) m_width * 3;
+    std::vector<uint8_t> flipped(stride * m_height);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, m_framebuffer);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, m_width, m_height, GL_RGB, GL_UNSIGNED_BYTE, flipped.data());
+    pixels.resize(flipped.size());
+    for (int y = 0; y < m_height; y++) {
+        memcpy(pixels.data() + y * stride, flipped.data() + (m_height - 1 - y) * stride, stride);
+    }
+}
@@ -0,0 +1,82 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+#include "HeightmapImporter.hpp"
+
+// image must stay loaded while importing
+HeightmapImporter::HeightmapImporter(const Image& image, int worldHeight) : m_image(image) {
+    m_worldHeight = worldHeight;
+    m_jobs = nullptr;
+    m_stats = {0, 0, 0, 0.0};
+}
+
+HeightmapImporter::~HeightmapImporter() {}
+
+// Fill tiles on the workers of jobs instead of the calling thread
+void HeightmapImporter::SetJobSystem(JobSystem* jobs) {
+    m_jobs = jobs;
+}
+
+// Read the heights of the tile at tileX, tileZ, counted in tiles
+// Tiles on the far edges are cut to the image.
+void HeightmapImporter::readTile(int tileX, int tileZ, HeightTile& tile) const {
+    tile.x = tileX * IMPORT_TILE_SIZE;
+    tile.z = tileZ * IMPORT_TILE_SIZE;
+    tile.width = std::min(IMPORT_TILE_SIZE, m_image.GetWidth() - tile.x);
+    tile.depth = std::min(IMPORT_TILE_SIZE, m_image.GetHeight() - tile.z);
+    tile.heights.resize(tile.width * tile.depth);
+    for (int i = 0; i < tile.width; i++) {
+        for (int j = 0; j < tile.depth; j++) {
+            unsigned int sample = m_image.GetSample(tile.x + i, tile.z + j, 0);
+            tile.heights[i*tile.depth + j] = ((float) sample / m_image.GetMaxValue()) * m_worldHeight;
+        }
+    }
+}
+
+// Fill every tile of the image and pass its chunk columns to sink
+// Each job of a wave writes only its own slot of waveColumns, so the
+// slots need no locking.
+const ImportStats& HeightmapImporter::Import(const WaveSink& sink) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    m_stats = {0, 0, 0, 0.0};
+    int tilesX = (m_image.GetWidth() + IMPORT_TILE_SIZE - 1) / IMPORT_TILE_SIZE;
+    int tilesZ = (m_image.GetHeight() + IMPORT_TILE_SIZE - 1) / IMPORT_TILE_SIZE;
+    int tileCount = tilesX * tilesZ;
+    // One tile per worker plus one for the importing thread, which helps in Wait
+    int waveSize = m_jobs != nullptr ? m_jobs->GetWorkerCount() + 1 : 1;
+    std::vector<std::vector<GeneratedColumn>> waveColumns(waveSize);
+    for (int waveStart = 0; waveStart < tileCount; waveStart += waveSize) {
+        int waveEnd = std::min(waveStart + waveSize, tileCount);
+        for (int tile = waveStart; tile < waveEnd; tile++) {
+            std::vector<GeneratedColumn>* columns = &waveColumns[tile - waveStart];
+            std::function<void()> job = [this, tile, tilesZ, columns]() {
+                HeightTile heights;
+                readTile(tile / tilesZ, tile % tilesZ, heights);
+                FillTerrainTile(heights, m_worldHeight, *columns);
+            };
+            if (m_jobs != nullptr) {
+                m_jobs->Submit(std::move(job));
+            }
+            else {
+                job();
+            }
+        }
+        if (m_jobs != nullptr) {
+            m_jobs->Wait();
+        }
+        std::vector<GeneratedColumn> wave;
+        for (int slot = 0; slot < waveEnd - waveStart; slot++) {
+            for (GeneratedColumn& column : waveColumns[slot]) {
+                wave.push_back(std::move(column));
+            }
+            waveColumns[slot].clear();
+        }
+        m_stats.columns += wave.size();
+        sink(wave);
+        m_stats.tiles += waveEnd - waveStart;
+        m_stats.tilesInFlight = std::max(m_stats.tilesInFlight, (unsigned int) (waveEnd - waveStart));
+    }
+    m_stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return m_stats;
+}
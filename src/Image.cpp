@@ -1,9 +1,20 @@
 #include "Image.hpp"
+#include "Compression.hpp"
+#include "stb_image.h"
+#include <chrono>
+#include <ctype.h>
 #include <fstream>
 #include <iostream>
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <memory>
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 // Constructor
 Image::Image(std::string filepath) : m_filepath(filepath){
@@ -15,86 +26,222 @@ Image::~Image (){
     // Delete our pixel data.
     // Note: We could actually do this sooner
     // in our rendering process.
-    if(m_pixelData!=NULL){
-        delete[] m_pixelData;
-    }
+    release();
 }
 
 // Little function for loading the pixel data
 // from a PPM image.
-// TODO: Expects a very specific version of PPM!
 //
 // flip - Will flip the pixels upside down in the data
 //        If you use this be consistent.
 void Image::LoadPPM(bool flip){
+    Load(flip);
+}
+
+// Loads a P2/P3/P5/P6 PNM, or any format stb_image reads
+// The file is mapped (or read in one go where mmap is missing) and
+// binary PNM samples are used where they lie, so loading costs about
+// as much as touching the pages.
+bool Image::Load(bool flip){
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    release();
+    m_flip = flip;
+    const uint8_t* data = nullptr;
+    std::size_t size = 0;
+#if defined(_WIN32)
+    std::vector<uint8_t> file;
+    FILE* input = fopen(m_filepath.c_str(), "rb");
+    if (input != NULL) {
+        fseek(input, 0, SEEK_END);
+        long length = ftell(input);
+        fseek(input, 0, SEEK_SET);
+        if (length > 0) {
+            file.resize(length);
+            size = fread(file.data(), 1, file.size(), input);
+        }
+        fclose(input);
+    }
+    data = file.data();
+#else
+    int fd = open(m_filepath.c_str(), O_RDONLY);
+    struct stat info;
+    if (fd >= 0 && fstat(fd, &info) == 0 && info.st_size > 0) {
+        // Private and writable so SetPixel changes only our copy of a page
+        void* mapping = mmap(nullptr, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (mapping != MAP_FAILED) {
+            m_mapping = mapping;
+            m_mappingSize = info.st_size;
+            data = (const uint8_t*) mapping;
+            size = info.st_size;
+        }
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+#endif
+    if (size == 0) {
+        std::cout << "Unable to open image file:" << m_filepath << std::endl;
+        return false;
+    }
+
+    bool success;
+    if (size >= 2 && data[0] == 'P' && (data[1] == '2' || data[1] == '3' || data[1] == '5' || data[1] == '6')) {
+        success = parsePNM(data, size);
+        bool binary = data[1] == '5' || data[1] == '6';
+#if defined(_WIN32)
+        if (success && binary) {
+            // Swapping keeps the buffer, and the pixel pointer into it, in place
+            m_buffer.swap(file);
+        }
+#else
+        if (!binary && m_mapping != nullptr) {
+            // ASCII samples were copied out, the file is not needed anymore
+            munmap(m_mapping, m_mappingSize);
+            m_mapping = nullptr;
+        }
+#endif
+    }
+    else {
+#if !defined(_WIN32)
+        munmap(m_mapping, m_mappingSize);
+        m_mapping = nullptr;
+#endif
+        success = loadWithStb();
+    }
+    if (!success) {
+        release();
+        return false;
+    }
+    m_BPP = m_channels * m_bytesPerSample * 8;
+    double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Loaded " << m_filepath << " (" << magicNumber << "): " << m_width << "x" << m_height << ", "
+        << m_channels << " channels, " << m_bytesPerSample * 8 << " bit in " << milliseconds << " ms" << std::endl;
+    return true;
+}
 
-  // Open an input file stream for reading a file
-  std::ifstream ppmFile(m_filepath.c_str());
-  // If our file successfully opens, begin to process it.
-  if (ppmFile.is_open()){
-      // line will store one line of input
-      std::string line;
-      // Our loop invariant is to continue reading input until
-      // we reach the end of the file and it reads in a NULL character
-      std::cout << "Reading in ppm file: " << m_filepath << std::endl;
-      unsigned int iteration = 0;
-      unsigned int pos = 0;
-      while ( getline (ppmFile,line) ){
-         // Ignore comments in the file
-         if (line[0]=='#'){
-            continue;
-         }
-         if(line[0]=='P'){
-            magicNumber = line;
-         }else if(iteration==1){
-            // Returns first token
-            char *token = strtok((char*)line.c_str(), " ");
-            m_width = atoi(token);
-            token = strtok(NULL, " ");
-            m_height = atoi(token);
-            std::cout << "PPM width,height=" << m_width << "," << m_height << std::endl;
-            if(m_width > 0 && m_height > 0){
-                m_pixelData = new uint8_t[m_width*m_height*3];
-                if(m_pixelData==NULL){
-                    std::cout << "Unable to allocate memory for ppm" << std::endl;
-                    exit(1);
-                 }
-             }else{
-                std::cout << "PPM not parsed correctly, width and/or height dimensions are 0" << std::endl;
-                exit(1);
-             }
-         }else if(iteration==2){
-            // max color range is stored here
-            // TODO: Can be stored optionally
-         }else{
-            m_pixelData[pos] = (uint8_t)atoi(line.c_str());
+// Skip whitespace and # comments, then read an unsigned decimal number
+// Returns false at the end of the data or on anything but a digit.
+static bool readNumber(const uint8_t* data, std::size_t size, std::size_t& pos, unsigned int& value){
+    while (pos < size) {
+        if (data[pos] == '#') {
+            while (pos < size && data[pos] != '\n') {
+                ++pos;
+            }
+        }
+        else if (isspace(data[pos])) {
             ++pos;
-         }
-          iteration++;
+        }
+        else {
+            break;
+        }
     }
-    ppmFile.close();
-  }
-  else{
-      std::cout << "Unable to open ppm file:" << m_filepath << std::endl;
-  }
+    if (pos >= size || !isdigit(data[pos])) {
+        return false;
+    }
+    value = 0;
+    while (pos < size && isdigit(data[pos])) {
+        value = value * 10 + (data[pos] - '0');
+        ++pos;
+    }
+    return true;
+}
 
-    // Flip all of the pixels
-    if(flip){
-        // Copy all of the data to a temporary stack-allocated array
-        uint8_t* copyData = new uint8_t[m_width*m_height*3];
-        for(int i =0; i < m_width*m_height*3; ++i){
-            copyData[i]=m_pixelData[i];
+// Parse a PNM file held in memory
+// P5/P6 samples are used in place, P2/P3 samples are parsed into
+// m_buffer in the same layout, 16 bit ones big endian.
+bool Image::parsePNM(const uint8_t* data, std::size_t size){
+    magicNumber = std::string((const char*) data, 2);
+    bool binary = data[1] == '5' || data[1] == '6';
+    m_channels = (data[1] == '3' || data[1] == '6') ? 3 : 1;
+    std::size_t pos = 2;
+    unsigned int width = 0;
+    unsigned int height = 0;
+    unsigned int maxValue = 0;
+    if (!readNumber(data, size, pos, width) || !readNumber(data, size, pos, height) ||
+        !readNumber(data, size, pos, maxValue) || width == 0 || height == 0 ||
+        maxValue == 0 || maxValue > 65535) {
+        std::cout << "PPM not parsed correctly, bad header in " << m_filepath << std::endl;
+        return false;
+    }
+    m_width = width;
+    m_height = height;
+    m_maxValue = maxValue;
+    m_bytesPerSample = maxValue > 255 ? 2 : 1;
+    m_bigEndian = true;
+    std::size_t samples = (std::size_t) m_width * m_height * m_channels;
+    if (binary) {
+        // A single whitespace byte separates the header from the samples
+        ++pos;
+        if (size < pos || size - pos < samples * m_bytesPerSample) {
+            std::cout << "PPM not parsed correctly, " << m_filepath << " is truncated" << std::endl;
+            return false;
         }
-        //memcpy(copyData,m_pixelData,(m_width*m_height*3)*sizeof(uint8_t));
-        unsigned int pos = (m_width*m_height*3)-1;
-        for(int i =0; i < m_width*m_height*3; i+=3){
-            m_pixelData[pos]=copyData[i+2];
-            m_pixelData[pos-1]=copyData[i+1];
-            m_pixelData[pos-2]=copyData[i];
-            pos-=3;
+        m_pixelData = (uint8_t*) data + pos;
+        return true;
+    }
+    m_buffer.resize(samples * m_bytesPerSample);
+    for (std::size_t i = 0; i < samples; ++i) {
+        unsigned int value;
+        if (!readNumber(data, size, pos, value)) {
+            std::cout << "PPM not parsed correctly, " << m_filepath << " has " << i << " of " << samples << " samples" << std::endl;
+            return false;
+        }
+        if (m_bytesPerSample == 1) {
+            m_buffer[i] = (uint8_t) value;
+        }
+        else {
+            m_buffer[2*i] = (uint8_t) (value >> 8);
+            m_buffer[2*i + 1] = (uint8_t) value;
         }
-        delete[] copyData;
     }
+    m_pixelData = m_buffer.data();
+    return true;
+}
+
+// Decode the file with stb_image, keeping 16 bit PNGs at 16 bits
+bool Image::loadWithStb(){
+    int width;
+    int height;
+    int channels;
+    if (stbi_is_16_bit(m_filepath.c_str())) {
+        m_stbData = (uint8_t*) stbi_load_16(m_filepath.c_str(), &width, &height, &channels, 0);
+        m_bytesPerSample = 2;
+        m_maxValue = 65535;
+    }
+    else {
+        m_stbData = stbi_load(m_filepath.c_str(), &width, &height, &channels, 0);
+        m_bytesPerSample = 1;
+        m_maxValue = 255;
+    }
+    if (m_stbData == nullptr) {
+        std::cout << "Image load failed: " << m_filepath << ": " << stbi_failure_reason() << std::endl;
+        return false;
+    }
+    magicNumber = "stb";
+    m_width = width;
+    m_height = height;
+    m_channels = channels;
+    // stb_image returns 16 bit samples in the byte order of the machine
+    uint16_t probe = 1;
+    m_bigEndian = *(uint8_t*) &probe == 0;
+    m_pixelData = m_stbData;
+    return true;
+}
+
+// Release the pixel data, whichever way it was stored
+void Image::release(){
+    std::vector<uint8_t>().swap(m_buffer);
+    if (m_stbData != nullptr) {
+        stbi_image_free(m_stbData);
+        m_stbData = nullptr;
+    }
+#if !defined(_WIN32)
+    if (m_mapping != nullptr) {
+        munmap(m_mapping, m_mappingSize);
+        m_mapping = nullptr;
+    }
+#endif
+    m_pixelData = nullptr;
 }
 
 /*  ===============================================
@@ -103,7 +250,7 @@ Precondition:
 Post-condition:
 =============================================== */
 void Image::SetPixel(int x, int y, uint8_t r, uint8_t g, uint8_t b){
-  if(x > m_width || y > m_height){
+  if(m_pixelData==nullptr || x < 0 || y < 0 || x >= m_width || y >= m_height){
     return;
   }
   else{
@@ -111,9 +258,21 @@ void Image::SetPixel(int x, int y, uint8_t r, uint8_t g, uint8_t b){
               << x << "," << y << "from (" <<
               (int)color[x*y] << "," << (int)color[x*y+1] << "," <<
 (int)color[x*y+2] << ")";*/
-    m_pixelData[(x*3)+m_height*(y*3)] = r;
-    m_pixelData[(x*3)+m_height*(y*3)+1] = g;
-    m_pixelData[(x*3)+m_height*(y*3)+2] = b;
+    const uint8_t color[3] = {r, g, b};
+    for(int channel = 0; channel < m_channels && channel < 3; ++channel){
+        // Scale 0-255 to the range of the samples
+        unsigned int value = color[channel] * m_maxValue / 255;
+        uint8_t* sample = m_pixelData + sampleOffset(x, y, channel);
+        if(m_bytesPerSample == 1){
+            sample[0] = (uint8_t)value;
+        }else if(m_bigEndian){
+            sample[0] = (uint8_t)(value >> 8);
+            sample[1] = (uint8_t)value;
+        }else{
+            sample[0] = (uint8_t)value;
+            sample[1] = (uint8_t)(value >> 8);
+        }
+    }
 /*    std::cout << " to (" << (int)color[x*y] << "," << (int)color[x*y+1] << ","
 << (int)color[x*y+2] << ")" << std::endl;*/
   }
@@ -125,7 +284,7 @@ Precondition:
 Post-condition:
 =============================================== */
 void Image::PrintPixels(){
-    for(int x = 0; x <  m_width*m_height*3; ++x){
+    for(int x = 0; x <  m_width*m_height*m_channels*m_bytesPerSample; ++x){
         std::cout << " " << (int)m_pixelData[x];
     }
     std::cout << "\n";
@@ -139,3 +298,118 @@ Post-condition:
 uint8_t* Image::GetPixelDataPtr(){
     return m_pixelData;
 }
+
+// CRC-32 of PNG chunks, continuing from crc
+static uint32_t crc32(uint32_t crc, const uint8_t* data, std::size_t size){
+    static uint32_t table[256];
+    static bool tableReady = false;
+    if (!tableReady) {
+        for (uint32_t n = 0; n < 256; n++) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            }
+            table[n] = c;
+        }
+        tableReady = true;
+    }
+    crc = ~crc;
+    for (std::size_t i = 0; i < size; i++) {
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static void writeBigEndian(std::vector<uint8_t>& out, uint32_t value){
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        out.push_back((uint8_t) (value >> shift));
+    }
+}
+
+// Length, type, data and CRC of the type and data
+static void writeChunk(std::vector<uint8_t>& out, const char* type, const std::vector<uint8_t>& data){
+    writeBigEndian(out, data.size());
+    std::size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    writeBigEndian(out, crc32(0, out.data() + start, out.size() - start));
+}
+
+static uint8_t paeth(int a, int b, int c){
+    int p = a + b - c;
+    int pa = abs(p - a);
+    int pb = abs(p - b);
+    int pc = abs(p - c);
+    if (pa <= pb && pa <= pc) {
+        return a;
+    }
+    return pb <= pc ? b : c;
+}
+
+// Every row is filtered the way that leaves the smallest differences,
+// the usual heuristic, which turns flat and repeating areas into zeros
+bool WritePNG(const std::string& path, int width, int height, const uint8_t* pixels){
+    std::size_t stride = (std::size_t) width * 3;
+    std::vector<uint8_t> filtered;
+    filtered.reserve((stride + 1) * height);
+    std::vector<uint8_t> candidate(stride);
+    std::vector<uint8_t> best(stride);
+    std::vector<uint8_t> zeros(stride, 0);
+    for (int y = 0; y < height; y++) {
+        const uint8_t* row = pixels + y * stride;
+        const uint8_t* above = y > 0 ? row - stride : zeros.data();
+        unsigned long bestSum = ~0ul;
+        uint8_t bestFilter = 0;
+        for (uint8_t filter = 0; filter < 5; filter++) {
+            unsigned long sum = 0;
+            for (std::size_t i = 0; i < stride; i++) {
+                int left = i >= 3 ? row[i - 3] : 0;
+                int upLeft = i >= 3 ? above[i - 3] : 0;
+                int predicted = 0;
+                if (filter == 1) {
+                    predicted = left;
+                }
+                else if (filter == 2) {
+                    predicted = above[i];
+                }
+                else if (filter == 3) {
+                    predicted = (left + above[i]) / 2;
+                }
+                else if (filter == 4) {
+                    predicted = paeth(left, above[i], upLeft);
+                }
+                candidate[i] = (uint8_t) (row[i] - predicted);
+                sum += candidate[i] < 128 ? candidate[i] : 256 - candidate[i];
+            }
+            if (sum < bestSum) {
+                bestSum = sum;
+                bestFilter = filter;
+                best.swap(candidate);
+            }
+        }
+        filtered.push_back(bestFilter);
+        filtered.insert(filtered.end(), best.begin(), best.end());
+    }
+    std::vector<uint8_t> file = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    std::vector<uint8_t> header;
+    writeBigEndian(header, width);
+    writeBigEndian(header, height);
+    // 8 bits per sample, RGB, deflate, adaptive filtering, no interlace
+    header.insert(header.end(), {8, 2, 0, 0, 0});
+    writeChunk(file, "IHDR", header);
+    std::vector<uint8_t> data;
+    CompressZlib(filtered.data(), filtered.size(), data);
+    writeChunk(file, "IDAT", data);
+    writeChunk(file, "IEND", std::vector<uint8_t>());
+    FILE* output = fopen(path.c_str(), "wb");
+    if (output == NULL) {
+        std::cout << "Could not write " << path << std::endl;
+        return false;
+    }
+    bool written = fwrite(file.data(), 1, file.size(), output) == file.size();
+    written = fclose(output) == 0 && written;
+    if (!written) {
+        std::cout << "Could not write " << path << std::endl;
+    }
+    return written;
+}
@@ -0,0 +1,188 @@
+#include "InputScript.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+InputScript::InputScript() {
+    m_length = 0;
+    m_next = 0;
+}
+
+InputScript::~InputScript() {}
+
+static SDL_Event keyEvent(SDL_Keycode key) {
+    SDL_Event event;
+    memset(&event, 0, sizeof(event));
+    event.type = SDL_KEYDOWN;
+    event.key.keysym.sym = key;
+    return event;
+}
+
+static SDL_Event motionEvent(int x, int y) {
+    SDL_Event event;
+    memset(&event, 0, sizeof(event));
+    event.type = SDL_MOUSEMOTION;
+    event.motion.x = x;
+    event.motion.y = y;
+    return event;
+}
+
+static SDL_Event clickEvent(int button) {
+    SDL_Event event;
+    memset(&event, 0, sizeof(event));
+    event.type = SDL_MOUSEBUTTONDOWN;
+    event.button.button = button;
+    return event;
+}
+
+// The camera starts with its last mouse position at 0, 0, so y = 50
+// pitches it 25 degrees down and every pixel of x turns it half a degree
+InputScript InputScript::Flight() {
+    InputScript script;
+    script.add(0, motionEvent(0, 50));
+    unsigned int frame = 1;
+    for (int i = 0; i < 30; i++) {
+        script.add(frame++, keyEvent(SDLK_SPACE));
+    }
+    for (int i = 0; i < FLIGHT_FRAMES; i++) {
+        script.add(frame, keyEvent(SDLK_w));
+        script.add(frame, motionEvent(i, 50));
+        if (i % 40 == 0) {
+            script.add(frame, clickEvent(SDL_BUTTON_LEFT));
+        }
+        else if (i % 40 == 20) {
+            script.add(frame, clickEvent(SDL_BUTTON_RIGHT));
+        }
+        frame++;
+    }
+    script.SetLength(frame);
+    return script;
+}
+
+bool InputScript::Load(const std::string& path) {
+    std::ifstream input(path.c_str());
+    if (!input.is_open()) {
+        std::cout << "Could not open input script " << path << std::endl;
+        return false;
+    }
+    m_events.clear();
+    m_length = 0;
+    m_next = 0;
+    bool ended = false;
+    std::string line;
+    unsigned int lineNumber = 0;
+    while (!ended && std::getline(input, line)) {
+        lineNumber++;
+        std::istringstream words(line);
+        unsigned int frame;
+        std::string kind;
+        if (line.empty() || line[0] == '#' || !(words >> frame >> kind)) {
+            continue;
+        }
+        if (!m_events.empty() && frame < m_events.back().frame) {
+            std::cout << path << ":" << lineNumber << ": frames must not go back" << std::endl;
+            return false;
+        }
+        bool valid = true;
+        if (kind == "key") {
+            std::string name;
+            std::getline(words >> std::ws, name);
+            SDL_Keycode key = SDL_GetKeyFromName(name.c_str());
+            valid = key != 0;
+            add(frame, keyEvent(key));
+        }
+        else if (kind == "motion") {
+            int x, y;
+            valid = (bool) (words >> x >> y);
+            add(frame, motionEvent(x, y));
+        }
+        else if (kind == "click") {
+            std::string button;
+            words >> button;
+            valid = button == "left" || button == "right";
+            add(frame, clickEvent(button == "left" ? SDL_BUTTON_LEFT : SDL_BUTTON_RIGHT));
+        }
+        else if (kind == "end") {
+            m_length = frame;
+            ended = true;
+        }
+        else {
+            valid = false;
+        }
+        if (!valid) {
+            std::cout << path << ":" << lineNumber << ": unknown event " << line << std::endl;
+            return false;
+        }
+    }
+    if (!ended) {
+        std::cout << path << " has no end line" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool InputScript::Save(const std::string& path) const {
+    std::ofstream output(path.c_str());
+    output << "# frame event, one frame per fixed step" << std::endl;
+    for (const ScriptEvent& scripted : m_events) {
+        const SDL_Event& event = scripted.event;
+        output << scripted.frame << " ";
+        if (event.type == SDL_KEYDOWN) {
+            output << "key " << SDL_GetKeyName(event.key.keysym.sym) << std::endl;
+        }
+        else if (event.type == SDL_MOUSEMOTION) {
+            output << "motion " << event.motion.x << " " << event.motion.y << std::endl;
+        }
+        else {
+            output << "click " << (event.button.button == SDL_BUTTON_LEFT ? "left" : "right") << std::endl;
+        }
+    }
+    output << m_length << " end" << std::endl;
+    output.close();
+    if (!output) {
+        std::cout << "Could not write input script " << path << std::endl;
+        return false;
+    }
+    std::cout << "Recorded " << m_events.size() << " events over " << m_length << " frames to " << path << std::endl;
+    return true;
+}
+
+// Only what the loop reacts to is kept, key names that have no name in
+// SDL could not be loaded again
+void InputScript::Record(unsigned int frame, const SDL_Event& event) {
+    if (event.type == SDL_KEYDOWN && SDL_GetKeyName(event.key.keysym.sym)[0] != '\0') {
+        add(frame, keyEvent(event.key.keysym.sym));
+    }
+    else if (event.type == SDL_MOUSEMOTION) {
+        add(frame, motionEvent(event.motion.x, event.motion.y));
+    }
+    else if (event.type == SDL_MOUSEBUTTONDOWN &&
+        (event.button.button == SDL_BUTTON_LEFT || event.button.button == SDL_BUTTON_RIGHT)) {
+        add(frame, clickEvent(event.button.button));
+    }
+}
+
+void InputScript::SetLength(unsigned int frames) {
+    m_length = frames;
+}
+
+unsigned int InputScript::GetLength() const {
+    return m_length;
+}
+
+// Input of the window is dropped so moving the mouse or pressing keys
+// during a replay cannot change it, closing the window still works
+void InputScript::PushEvents(unsigned int frame) {
+    SDL_PumpEvents();
+    SDL_FlushEvents(SDL_KEYDOWN, SDL_MOUSEWHEEL);
+    while (m_next < m_events.size() && m_events[m_next].frame <= frame) {
+        SDL_PushEvent(&m_events[m_next].event);
+        m_next++;
+    }
+}
+
+void InputScript::add(unsigned int frame, const SDL_Event& event) {
+    m_events.push_back({frame, event});
+}
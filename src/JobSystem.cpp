@@ -0,0 +1,144 @@
+#include "JobSystem.hpp"
+#include "Profiler.hpp"
+
+#include <algorithm>
+
+// Index of the worker running on this thread, -1 outside the pool
+static thread_local int t_workerIndex = -1;
+
+JobSystem::JobSystem(unsigned int workerCount) {
+    if (workerCount == 0) {
+        unsigned int cores = std::thread::hardware_concurrency();
+        workerCount = cores > 1 ? cores - 1 : 1;
+    }
+    for (unsigned int i = 0; i < workerCount; i++) {
+        m_queues.emplace_back(new WorkerQueue());
+    }
+    for (unsigned int i = 0; i < workerCount; i++) {
+        m_workers.emplace_back(&JobSystem::workerLoop, this, i);
+    }
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    for (std::thread& worker : m_workers) {
+        worker.join();
+    }
+}
+
+void JobSystem::Submit(std::function<void()> job) {
+    unsigned int index = t_workerIndex >= 0 ? t_workerIndex : m_nextQueue++ % m_queues.size();
+    m_unfinishedJobs++;
+    {
+        std::lock_guard<std::mutex> lock(m_queues[index]->mutex);
+        m_queues[index]->jobs.push_back(std::move(job));
+    }
+    {
+        // Taken so a worker between its check and its wait cannot miss the wake up
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_queuedJobs++;
+    }
+    m_wake.notify_one();
+}
+
+void JobSystem::Wait() {
+    unsigned int index = t_workerIndex >= 0 ? t_workerIndex : 0;
+    std::function<void()> job;
+    while (m_unfinishedJobs > 0) {
+        if (popJob(index, job)) {
+            runJob(job);
+        }
+        else {
+            // The remaining jobs are running on other threads
+            std::this_thread::yield();
+        }
+    }
+}
+
+void JobSystem::ParallelFor(int count, const std::function<void(int, int)>& body) {
+    if (count <= 0) {
+        return;
+    }
+    // A few ranges per thread so a slow range does not leave the others idle
+    int threads = m_workers.size() + 1;
+    std::shared_ptr<ParallelRanges> ranges(new ParallelRanges());
+    ranges->body = &body;
+    ranges->count = count;
+    ranges->rangeSize = std::max(1, count / (threads * 4));
+    ranges->rangeCount = (count + ranges->rangeSize - 1) / ranges->rangeSize;
+    // Helpers starting after every range was claimed return without
+    // touching body, which may be gone by then
+    int helpers = std::min((int) m_workers.size(), ranges->rangeCount - 1);
+    for (int i = 0; i < helpers; i++) {
+        Submit([ranges]() {
+            runRanges(*ranges);
+        });
+    }
+    runRanges(*ranges);
+    while (ranges->finishedRanges < ranges->rangeCount) {
+        // The last ranges are running on other threads
+        std::this_thread::yield();
+    }
+}
+
+void JobSystem::runRanges(ParallelRanges& ranges) {
+    int range;
+    while ((range = ranges.nextRange++) < ranges.rangeCount) {
+        int begin = range * ranges.rangeSize;
+        (*ranges.body)(begin, std::min(begin + ranges.rangeSize, ranges.count));
+        ranges.finishedRanges++;
+    }
+}
+
+unsigned int JobSystem::GetWorkerCount() const {
+    return m_workers.size();
+}
+
+bool JobSystem::popJob(unsigned int index, std::function<void()>& job) {
+    {
+        WorkerQueue& own = *m_queues[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.jobs.empty()) {
+            job = std::move(own.jobs.back());
+            own.jobs.pop_back();
+            m_queuedJobs--;
+            return true;
+        }
+    }
+    // Steal the oldest job of the next worker that has one
+    for (unsigned int i = 1; i < m_queues.size(); i++) {
+        WorkerQueue& victim = *m_queues[(index + i) % m_queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.jobs.empty()) {
+            job = std::move(victim.jobs.front());
+            victim.jobs.pop_front();
+            m_queuedJobs--;
+            return true;
+        }
+    }
+    return false;
+}
+
+void JobSystem::runJob(std::function<void()>& job) {
+    job();
+    job = nullptr;
+    m_unfinishedJobs--;
+}
+
+void JobSystem::workerLoop(unsigned int index) {
+    t_workerIndex = index;
+    Profiler::Instance().SetThreadName("Worker " + std::to_string(index));
+    std::function<void()> job;
+    while (!m_stop) {
+        if (popJob(index, job)) {
+            runJob(job);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_wake.wait(lock, [this] { return m_stop || m_queuedJobs > 0; });
+    }
+}
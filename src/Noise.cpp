@@ -0,0 +1,236 @@
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "Noise.hpp"
+
+// Multipliers of the lattice hash
+#define NOISE_HASH_X 0x27d4eb2du
+#define NOISE_HASH_Z 0x165667b1u
+#define NOISE_HASH_MIX 0x2c1b3c6du
+// Added to the seed for every octave so octaves are not correlated
+#define NOISE_OCTAVE_SEED 0x9e3779b9u
+
+FractalNoise::FractalNoise(uint32_t seed, int octaves, float frequency, float lacunarity, float gain) {
+    m_seed = seed;
+    m_octaves = octaves;
+    m_frequency = frequency;
+    m_lacunarity = lacunarity;
+    m_gain = gain;
+}
+
+const char* FractalNoise::GetSimdPath() {
+#if defined(__AVX2__)
+    return "AVX2";
+#elif defined(__SSE2__)
+    return "SSE2";
+#else
+    return "scalar";
+#endif
+}
+
+// Noise at x[i], z[i] for i < count, written to out[i], within [-1, 1]
+// Octave amplitudes are normalized by their sum.
+void FractalNoise::Sample(const float* x, const float* z, int count, float* out) const {
+    for (int i = 0; i < count; i++) {
+        out[i] = 0.0f;
+    }
+    float frequency = m_frequency;
+    float amplitude = 1.0f;
+    float amplitudeSum = 0.0f;
+    for (int octave = 0; octave < m_octaves; octave++) {
+        addOctave(x, z, count, frequency, amplitude, m_seed + octave * NOISE_OCTAVE_SEED, out);
+        amplitudeSum += amplitude;
+        frequency *= m_lacunarity;
+        amplitude *= m_gain;
+    }
+    float scale = 1.0f / amplitudeSum;
+    for (int i = 0; i < count; i++) {
+        out[i] *= scale;
+    }
+}
+
+// Hash of the lattice point ix, iz
+static inline uint32_t hashLattice(int32_t ix, int32_t iz, uint32_t seed) {
+    uint32_t h = seed ^ ((uint32_t) ix * NOISE_HASH_X) ^ ((uint32_t) iz * NOISE_HASH_Z);
+    h ^= h >> 15;
+    h *= NOISE_HASH_MIX;
+    h ^= h >> 12;
+    return h;
+}
+
+// Dot product of the offset with one of four diagonal gradients
+static inline float gradient(uint32_t h, float dx, float dz) {
+    return ((h & 1) ? -dx : dx) + ((h & 2) ? -dz : dz);
+}
+
+// Perlin's quintic fade curve
+static inline float fade(float t) {
+    return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+}
+
+// One octave of noise at a single point
+static inline float noisePoint(float x, float z, uint32_t seed) {
+    float fx = std::floor(x);
+    float fz = std::floor(z);
+    int32_t ix = (int32_t) fx;
+    int32_t iz = (int32_t) fz;
+    float dx = x - fx;
+    float dz = z - fz;
+    float u = fade(dx);
+    float v = fade(dz);
+    float n00 = gradient(hashLattice(ix, iz, seed), dx, dz);
+    float n10 = gradient(hashLattice(ix + 1, iz, seed), dx - 1.0f, dz);
+    float n01 = gradient(hashLattice(ix, iz + 1, seed), dx, dz - 1.0f);
+    float n11 = gradient(hashLattice(ix + 1, iz + 1, seed), dx - 1.0f, dz - 1.0f);
+    float nx0 = n00 + u * (n10 - n00);
+    float nx1 = n01 + u * (n11 - n01);
+    return nx0 + v * (nx1 - nx0);
+}
+
+#if defined(__AVX2__)
+
+// 8 lanes of hashLattice
+static inline __m256i hashLattice8(__m256i ix, __m256i iz, __m256i seed) {
+    __m256i h = _mm256_xor_si256(seed, _mm256_xor_si256(
+        _mm256_mullo_epi32(ix, _mm256_set1_epi32((int) NOISE_HASH_X)),
+        _mm256_mullo_epi32(iz, _mm256_set1_epi32((int) NOISE_HASH_Z))));
+    h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 15));
+    h = _mm256_mullo_epi32(h, _mm256_set1_epi32((int) NOISE_HASH_MIX));
+    return _mm256_xor_si256(h, _mm256_srli_epi32(h, 12));
+}
+
+// 8 lanes of gradient, the hash bits flip the sign bits of the offsets
+static inline __m256 gradient8(__m256i h, __m256 dx, __m256 dz) {
+    __m256 signX = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(h, _mm256_set1_epi32(1)), 31));
+    __m256 signZ = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(h, _mm256_set1_epi32(2)), 30));
+    return _mm256_add_ps(_mm256_xor_ps(dx, signX), _mm256_xor_ps(dz, signZ));
+}
+
+// 8 lanes of fade
+static inline __m256 fade8(__m256 t) {
+    __m256 inner = _mm256_add_ps(_mm256_mul_ps(t, _mm256_sub_ps(_mm256_mul_ps(t, _mm256_set1_ps(6.0f)), _mm256_set1_ps(15.0f))), _mm256_set1_ps(10.0f));
+    return _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(t, t), t), inner);
+}
+
+// 8 lanes of noisePoint
+static inline __m256 noisePoint8(__m256 x, __m256 z, __m256i seed) {
+    __m256 fx = _mm256_floor_ps(x);
+    __m256 fz = _mm256_floor_ps(z);
+    __m256i ix = _mm256_cvttps_epi32(fx);
+    __m256i iz = _mm256_cvttps_epi32(fz);
+    __m256i one = _mm256_set1_epi32(1);
+    __m256 dx = _mm256_sub_ps(x, fx);
+    __m256 dz = _mm256_sub_ps(z, fz);
+    __m256 dx1 = _mm256_sub_ps(dx, _mm256_set1_ps(1.0f));
+    __m256 dz1 = _mm256_sub_ps(dz, _mm256_set1_ps(1.0f));
+    __m256 u = fade8(dx);
+    __m256 v = fade8(dz);
+    __m256 n00 = gradient8(hashLattice8(ix, iz, seed), dx, dz);
+    __m256 n10 = gradient8(hashLattice8(_mm256_add_epi32(ix, one), iz, seed), dx1, dz);
+    __m256 n01 = gradient8(hashLattice8(ix, _mm256_add_epi32(iz, one), seed), dx, dz1);
+    __m256 n11 = gradient8(hashLattice8(_mm256_add_epi32(ix, one), _mm256_add_epi32(iz, one), seed), dx1, dz1);
+    __m256 nx0 = _mm256_add_ps(n00, _mm256_mul_ps(u, _mm256_sub_ps(n10, n00)));
+    __m256 nx1 = _mm256_add_ps(n01, _mm256_mul_ps(u, _mm256_sub_ps(n11, n01)));
+    return _mm256_add_ps(nx0, _mm256_mul_ps(v, _mm256_sub_ps(nx1, nx0)));
+}
+
+#define NOISE_LANES 8
+
+#elif defined(__SSE2__)
+
+// Low 32 bits of the lane products, SSE2 has no 32 bit multiply
+static inline __m128i mullo4(__m128i a, __m128i b) {
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+// Round down, SSE2 only truncates
+static inline __m128 floor4(__m128 x) {
+    __m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+    return _mm_sub_ps(truncated, _mm_and_ps(_mm_cmplt_ps(x, truncated), _mm_set1_ps(1.0f)));
+}
+
+// 4 lanes of hashLattice
+static inline __m128i hashLattice4(__m128i ix, __m128i iz, __m128i seed) {
+    __m128i h = _mm_xor_si128(seed, _mm_xor_si128(
+        mullo4(ix, _mm_set1_epi32((int) NOISE_HASH_X)),
+        mullo4(iz, _mm_set1_epi32((int) NOISE_HASH_Z))));
+    h = _mm_xor_si128(h, _mm_srli_epi32(h, 15));
+    h = mullo4(h, _mm_set1_epi32((int) NOISE_HASH_MIX));
+    return _mm_xor_si128(h, _mm_srli_epi32(h, 12));
+}
+
+// 4 lanes of gradient, the hash bits flip the sign bits of the offsets
+static inline __m128 gradient4(__m128i h, __m128 dx, __m128 dz) {
+    __m128 signX = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(1)), 31));
+    __m128 signZ = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(2)), 30));
+    return _mm_add_ps(_mm_xor_ps(dx, signX), _mm_xor_ps(dz, signZ));
+}
+
+// 4 lanes of fade
+static inline __m128 fade4(__m128 t) {
+    __m128 inner = _mm_add_ps(_mm_mul_ps(t, _mm_sub_ps(_mm_mul_ps(t, _mm_set1_ps(6.0f)), _mm_set1_ps(15.0f))), _mm_set1_ps(10.0f));
+    return _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(t, t), t), inner);
+}
+
+// 4 lanes of noisePoint
+static inline __m128 noisePoint4(__m128 x, __m128 z, __m128i seed) {
+    __m128 fx = floor4(x);
+    __m128 fz = floor4(z);
+    __m128i ix = _mm_cvttps_epi32(fx);
+    __m128i iz = _mm_cvttps_epi32(fz);
+    __m128i one = _mm_set1_epi32(1);
+    __m128 dx = _mm_sub_ps(x, fx);
+    __m128 dz = _mm_sub_ps(z, fz);
+    __m128 dx1 = _mm_sub_ps(dx, _mm_set1_ps(1.0f));
+    __m128 dz1 = _mm_sub_ps(dz, _mm_set1_ps(1.0f));
+    __m128 u = fade4(dx);
+    __m128 v = fade4(dz);
+    __m128 n00 = gradient4(hashLattice4(ix, iz, seed), dx, dz);
+    __m128 n10 = gradient4(hashLattice4(_mm_add_epi32(ix, one), iz, seed), dx1, dz);
+    __m128 n01 = gradient4(hashLattice4(ix, _mm_add_epi32(iz, one), seed), dx, dz1);
+    __m128 n11 = gradient4(hashLattice4(_mm_add_epi32(ix, one), _mm_add_epi32(iz, one), seed), dx1, dz1);
+    __m128 nx0 = _mm_add_ps(n00, _mm_mul_ps(u, _mm_sub_ps(n10, n00)));
+    __m128 nx1 = _mm_add_ps(n01, _mm_mul_ps(u, _mm_sub_ps(n11, n01)));
+    return _mm_add_ps(nx0, _mm_mul_ps(v, _mm_sub_ps(nx1, nx0)));
+}
+
+#define NOISE_LANES 4
+
+#else
+
+#define NOISE_LANES 1
+
+#endif
+
+// Add amplitude times one octave of noise at x[i], z[i] to out[i]
+// Full batches of lanes go through the vector path, the rest one by one.
+void FractalNoise::addOctave(const float* x, const float* z, int count, float frequency, float amplitude, uint32_t seed, float* out) const {
+    int i = 0;
+#if defined(__AVX2__)
+    __m256 frequency8 = _mm256_set1_ps(frequency);
+    __m256 amplitude8 = _mm256_set1_ps(amplitude);
+    __m256i seed8 = _mm256_set1_epi32((int) seed);
+    for (; i + NOISE_LANES <= count; i += NOISE_LANES) {
+        __m256 noise = noisePoint8(_mm256_mul_ps(_mm256_loadu_ps(x + i), frequency8), _mm256_mul_ps(_mm256_loadu_ps(z + i), frequency8), seed8);
+        _mm256_storeu_ps(out + i, _mm256_add_ps(_mm256_loadu_ps(out + i), _mm256_mul_ps(amplitude8, noise)));
+    }
+#elif defined(__SSE2__)
+    __m128 frequency4 = _mm_set1_ps(frequency);
+    __m128 amplitude4 = _mm_set1_ps(amplitude);
+    __m128i seed4 = _mm_set1_epi32((int) seed);
+    for (; i + NOISE_LANES <= count; i += NOISE_LANES) {
+        __m128 noise = noisePoint4(_mm_mul_ps(_mm_loadu_ps(x + i), frequency4), _mm_mul_ps(_mm_loadu_ps(z + i), frequency4), seed4);
+        _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(amplitude4, noise)));
+    }
+#endif
+    for (; i < count; i++) {
+        out[i] += amplitude * noisePoint(x[i] * frequency, z[i] * frequency, seed);
+    }
+}
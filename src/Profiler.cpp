@@ -0,0 +1,226 @@
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <map>
+
+thread_local Profiler::ThreadBuffer* Profiler::m_threadBuffer = nullptr;
+
+Profiler& Profiler::Instance() {
+    static Profiler* instance = new Profiler();
+    return *instance;
+}
+
+Profiler::Profiler() {
+    m_start = std::chrono::steady_clock::now();
+    m_frames = 0;
+}
+
+int64_t Profiler::Now() const {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start).count();
+}
+
+Profiler::ThreadBuffer& Profiler::threadBuffer() {
+    if (m_threadBuffer == nullptr) {
+        std::unique_ptr<ThreadBuffer> buffer(new ThreadBuffer());
+        buffer->depth = 0;
+        buffer->written = 0;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        buffer->id = m_buffers.size() + 1;
+        buffer->name = "Thread " + std::to_string(buffer->id);
+        m_threadBuffer = buffer.get();
+        m_buffers.push_back(std::move(buffer));
+    }
+    return *m_threadBuffer;
+}
+
+void Profiler::SetThreadName(const std::string& name) {
+    ThreadBuffer& buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    buffer.name = name;
+}
+
+uint32_t Profiler::BeginScope() {
+    return threadBuffer().depth++;
+}
+
+void Profiler::EndScope(const char* name, int64_t start, uint32_t depth) {
+    int64_t end = Now();
+    ThreadBuffer& buffer = *m_threadBuffer;
+    buffer.depth = depth;
+    uint64_t index = buffer.written.load(std::memory_order_relaxed);
+    buffer.events[index % PROFILER_RING_SIZE] = {name, start, end, depth};
+    buffer.written.store(index + 1, std::memory_order_release);
+}
+
+// The thread may overwrite the oldest scopes while they are copied, so
+// only the ones it could not have reached by the end of the copy are kept
+void Profiler::copyEvents(const ThreadBuffer& buffer, std::vector<ProfileEvent>& events) {
+    events.clear();
+    uint64_t written = buffer.written.load(std::memory_order_acquire);
+    uint64_t first = written > PROFILER_RING_SIZE ? written - PROFILER_RING_SIZE : 0;
+    std::vector<ProfileEvent> copied;
+    for (uint64_t i = first; i < written; i++) {
+        copied.push_back(buffer.events[i % PROFILER_RING_SIZE]);
+    }
+    // One more slot than was written may be in the middle of a write
+    uint64_t after = buffer.written.load(std::memory_order_acquire) + 1;
+    uint64_t safe = after > PROFILER_RING_SIZE ? after - PROFILER_RING_SIZE : 0;
+    for (uint64_t i = std::max(first, safe); i < written; i++) {
+        events.push_back(copied[i - first]);
+    }
+}
+
+void Profiler::MarkFrame() {
+    m_frameStarts[m_frames % (PROFILER_SUMMARY_FRAMES + 1)] = Now();
+    m_frames++;
+}
+
+// Scopes are grouped by their path from the outermost scope, so the same
+// function called from two places is listed twice. Every scope is listed
+// under its parent, in the order the scopes first ran.
+void Profiler::PrintSummary() {
+    // The newest mark starts the frame still running
+    uint64_t frameCount = std::min<uint64_t>(m_frames > 0 ? m_frames - 1 : 0, PROFILER_SUMMARY_FRAMES);
+    if (frameCount == 0) {
+        std::cout << "Profile: no frame finished yet" << std::endl;
+        return;
+    }
+    std::vector<int64_t> frameStarts;
+    for (uint64_t frame = m_frames - 1 - frameCount; frame < m_frames; frame++) {
+        frameStarts.push_back(m_frameStarts[frame % (PROFILER_SUMMARY_FRAMES + 1)]);
+    }
+    int64_t windowStart = frameStarts.front();
+    int64_t windowEnd = frameStarts.back();
+    std::ios_base::fmtflags flags = std::cout.flags();
+    std::streamsize precision = std::cout.precision();
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "Profile of the last " << frameCount << " frames, "
+        << (windowEnd - windowStart) / 1e6 / frameCount << " ms per frame" << std::endl;
+
+    struct ScopeSummary {
+        const char* name;
+        uint32_t depth;
+        // First run of every scope on the path, for the listing order
+        std::vector<int> order;
+        int64_t total{0};
+        unsigned int calls{0};
+        std::vector<int64_t> perFrame;
+    };
+    std::vector<std::string> names;
+    std::vector<const ThreadBuffer*> threads;
+    listThreads(names, threads);
+    std::vector<ProfileEvent> events;
+    for (unsigned int t = 0; t < threads.size(); t++) {
+        copyEvents(*threads[t], events);
+        events.erase(std::remove_if(events.begin(), events.end(), [&](const ProfileEvent& event) {
+            return event.start < windowStart || event.end > windowEnd;
+        }), events.end());
+        if (events.empty()) {
+            continue;
+        }
+        std::sort(events.begin(), events.end(), [](const ProfileEvent& a, const ProfileEvent& b) {
+            return a.start < b.start || (a.start == b.start && a.depth < b.depth);
+        });
+        std::map<std::string, ScopeSummary> scopes;
+        // Path of the scopes open at each depth
+        std::vector<std::string> paths;
+        std::vector<std::vector<int>> orders;
+        for (const ProfileEvent& event : events) {
+            // A parent that started before the window is left out of the path
+            paths.resize(event.depth + 1);
+            orders.resize(event.depth + 1);
+            std::string parent = event.depth > 0 ? paths[event.depth - 1] : std::string();
+            paths[event.depth] = parent + "/" + event.name;
+            ScopeSummary& scope = scopes[paths[event.depth]];
+            if (scope.calls == 0) {
+                scope.name = event.name;
+                scope.depth = event.depth;
+                scope.order = event.depth > 0 ? orders[event.depth - 1] : std::vector<int>();
+                scope.order.push_back(scopes.size());
+                scope.perFrame.resize(frameCount);
+            }
+            orders[event.depth] = scope.order;
+            int64_t duration = event.end - event.start;
+            unsigned int frame = std::upper_bound(frameStarts.begin(), frameStarts.end(), event.start) - frameStarts.begin() - 1;
+            scope.total += duration;
+            scope.calls++;
+            scope.perFrame[frame] += duration;
+        }
+        std::vector<const ScopeSummary*> listed;
+        for (const auto& entry : scopes) {
+            listed.push_back(&entry.second);
+        }
+        std::sort(listed.begin(), listed.end(), [](const ScopeSummary* a, const ScopeSummary* b) {
+            return a->order < b->order;
+        });
+        std::cout << names[t] << ":" << std::endl;
+        for (const ScopeSummary* scope : listed) {
+            std::string label = std::string(2 * (scope->depth + 1), ' ') + scope->name;
+            std::cout << std::left << std::setw(44) << label << std::right
+                << std::setw(9) << scope->total / 1e6 / frameCount << " ms/frame, max "
+                << std::setw(9) << *std::max_element(scope->perFrame.begin(), scope->perFrame.end()) / 1e6 << " ms, "
+                << std::setw(8) << (double) scope->calls / frameCount << " calls/frame" << std::endl;
+        }
+    }
+    std::cout.flags(flags);
+    std::cout.precision(precision);
+}
+
+// Names are string literals, only quotes and backslashes need escaping
+static void writeJsonString(FILE* output, const std::string& text) {
+    fputc('"', output);
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            fputc('\\', output);
+        }
+        fputc(c, output);
+    }
+    fputc('"', output);
+}
+
+void Profiler::listThreads(std::vector<std::string>& names, std::vector<const ThreadBuffer*>& buffers) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const std::unique_ptr<ThreadBuffer>& buffer : m_buffers) {
+        names.push_back(buffer->name);
+        buffers.push_back(buffer.get());
+    }
+}
+
+bool Profiler::WriteTrace(const std::string& path) {
+    FILE* output = fopen(path.c_str(), "w");
+    if (output == NULL) {
+        std::cout << "Could not write trace " << path << std::endl;
+        return false;
+    }
+    std::vector<std::string> names;
+    std::vector<const ThreadBuffer*> threads;
+    listThreads(names, threads);
+    fprintf(output, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(output, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"mc\"}}");
+    std::size_t count = 0;
+    std::vector<ProfileEvent> events;
+    for (unsigned int t = 0; t < threads.size(); t++) {
+        fprintf(output, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", threads[t]->id);
+        writeJsonString(output, names[t]);
+        fprintf(output, "}}");
+        copyEvents(*threads[t], events);
+        for (const ProfileEvent& event : events) {
+            fprintf(output, ",\n{\"name\":");
+            writeJsonString(output, event.name);
+            // Microseconds, as the format expects
+            fprintf(output, ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                threads[t]->id, event.start / 1000.0, (event.end - event.start) / 1000.0);
+        }
+        count += events.size();
+    }
+    fprintf(output, "\n]}\n");
+    if (fclose(output) != 0) {
+        std::cout << "Could not write trace " << path << std::endl;
+        return false;
+    }
+    std::cout << "Wrote " << count << " scopes of " << threads.size() << " threads to " << path << std::endl;
+    return true;
+}
@@ -0,0 +1,68 @@
+#include "Raycast.hpp"
+#include "Profiler.hpp"
+
+#include <cmath>
+#include <limits>
+
+bool RaycastBlocks(const BlocksArray& blocksArray, const glm::vec3& origin, const glm::vec3& direction, float maxDistance, RaycastHit& hit) {
+    PROFILE_SCOPE("RaycastBlocks");
+    if (glm::length(direction) == 0.0f) {
+        return false;
+    }
+    glm::vec3 dir = glm::normalize(direction);
+    // Blocks are centered on their coordinate, shift so block i spans [i, i + 1)
+    glm::vec3 start = origin + 0.5f;
+    int cell[3] = {(int) std::floor(start.x), (int) std::floor(start.y), (int) std::floor(start.z)};
+    int step[3];
+    // Ray distance to the next cell boundary and between boundaries on each axis
+    float tMax[3];
+    float tDelta[3];
+    // Face entered when stepping along each axis
+    int enteredFace[3];
+    const int positiveFaces[3] = {LeftFace, BottomFace, BackFace};
+    const int negativeFaces[3] = {RightFace, TopFace, FrontFace};
+    for (int k = 0; k < 3; k++) {
+        if (dir[k] > 0.0f) {
+            step[k] = 1;
+            tMax[k] = (cell[k] + 1 - start[k]) / dir[k];
+            tDelta[k] = 1.0f / dir[k];
+            enteredFace[k] = positiveFaces[k];
+        }
+        else if (dir[k] < 0.0f) {
+            step[k] = -1;
+            tMax[k] = (cell[k] - start[k]) / dir[k];
+            tDelta[k] = -1.0f / dir[k];
+            enteredFace[k] = negativeFaces[k];
+        }
+        else {
+            // Never crosses a boundary on this axis
+            step[k] = 0;
+            tMax[k] = std::numeric_limits<float>::infinity();
+            tDelta[k] = std::numeric_limits<float>::infinity();
+            enteredFace[k] = 0;
+        }
+    }
+
+    while (true) {
+        // Step across the nearest boundary
+        int axis = 0;
+        if (tMax[1] < tMax[axis]) {
+            axis = 1;
+        }
+        if (tMax[2] < tMax[axis]) {
+            axis = 2;
+        }
+        if (tMax[axis] > maxDistance) {
+            return false;
+        }
+        cell[axis] += step[axis];
+        tMax[axis] += tDelta[axis];
+        if (blocksArray.isVisibleBlock(cell[0], cell[1], cell[2])) {
+            hit.x = cell[0];
+            hit.y = cell[1];
+            hit.z = cell[2];
+            hit.face = enteredFace[axis];
+            return true;
+        }
+    }
+}
@@ -0,0 +1,446 @@
+#include "RegionFile.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+#include "Compression.hpp"
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+static const char REGION_MAGIC[4] = {'M', 'C', 'R', 'G'};
+
+static void put32(uint8_t* p, uint32_t value) {
+    p[0] = value & 0xff;
+    p[1] = (value >> 8) & 0xff;
+    p[2] = (value >> 16) & 0xff;
+    p[3] = value >> 24;
+}
+
+static uint32_t get32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static uint32_t sectorsFor(uint32_t bytes) {
+    return (bytes + REGION_SECTOR_SIZE - 1) / REGION_SECTOR_SIZE;
+}
+
+RegionFile::RegionFile(const std::string& path) : m_path(path) {
+    m_file = NULL;
+    memset(m_table, 0, sizeof(m_table));
+}
+
+RegionFile::~RegionFile() {
+    if (m_file != NULL) {
+        fclose(m_file);
+    }
+}
+
+// Open the file, creating an empty region if it does not exist
+bool RegionFile::Open() {
+    std::vector<uint8_t> header(REGION_HEADER_SECTORS * REGION_SECTOR_SIZE, 0);
+    m_file = fopen(m_path.c_str(), "r+b");
+    if (m_file == NULL) {
+        m_file = fopen(m_path.c_str(), "w+b");
+        if (m_file == NULL) {
+            std::cout << "Could not create region file " << m_path << std::endl;
+            return false;
+        }
+        memcpy(header.data(), REGION_MAGIC, sizeof(REGION_MAGIC));
+        put32(&header[4], REGION_VERSION);
+        m_usedSectors.assign(REGION_HEADER_SECTORS, true);
+        if (fwrite(header.data(), 1, header.size(), m_file) != header.size() || fflush(m_file) != 0) {
+            std::cout << "Could not write region file " << m_path << std::endl;
+            return false;
+        }
+        return true;
+    }
+    if (fread(header.data(), 1, REGION_HEADER_BYTES, m_file) != REGION_HEADER_BYTES ||
+        memcmp(header.data(), REGION_MAGIC, sizeof(REGION_MAGIC)) != 0) {
+        std::cout << m_path << " is not a region file" << std::endl;
+        return false;
+    }
+    if (get32(&header[4]) != REGION_VERSION) {
+        std::cout << m_path << " has unsupported region version " << get32(&header[4]) << std::endl;
+        return false;
+    }
+    fseek(m_file, 0, SEEK_END);
+    uint32_t fileSectors = sectorsFor(ftell(m_file));
+    m_usedSectors.assign(std::max(fileSectors, (uint32_t) REGION_HEADER_SECTORS), false);
+    for (int i = 0; i < REGION_HEADER_SECTORS; i++) {
+        m_usedSectors[i] = true;
+    }
+    for (int i = 0; i < REGION_COLUMNS; i++) {
+        Entry entry = {get32(&header[8 + i*8]), get32(&header[12 + i*8])};
+        if (entry.sector == 0) {
+            continue;
+        }
+        // A record outside the file is dropped, the column regenerates
+        if (entry.sector < REGION_HEADER_SECTORS || entry.size == 0 ||
+            entry.sector + sectorsFor(entry.size) > fileSectors) {
+            std::cout << m_path << ": column " << i << " points outside the file, ignored" << std::endl;
+            continue;
+        }
+        m_table[i] = entry;
+        markSectors(entry, true);
+    }
+    return true;
+}
+
+// Read the record of column index, false if it was never saved
+bool RegionFile::Read(int index, std::vector<uint8_t>& record) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const Entry& entry = m_table[index];
+    if (entry.sector == 0) {
+        return false;
+    }
+    record.resize(entry.size);
+    fseek(m_file, (long) entry.sector * REGION_SECTOR_SIZE, SEEK_SET);
+    if (fread(record.data(), 1, entry.size, m_file) != entry.size) {
+        std::cout << "Could not read column " << index << " of " << m_path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Replace the records of the columns at indices, each listed once
+// The new records go to free sectors and are synced before the header
+// entries are written, so the old records stay valid until the switch.
+// A header entry fits in one disk sector and is written in one piece.
+bool RegionFile::Write(const std::vector<int>& indices, const std::vector<const std::vector<uint8_t>*>& records) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<Entry> entries(indices.size());
+    bool written = true;
+    for (unsigned int i = 0; i < indices.size(); i++) {
+        entries[i] = {allocate(sectorsFor(records[i]->size())), (uint32_t) records[i]->size()};
+        fseek(m_file, (long) entries[i].sector * REGION_SECTOR_SIZE, SEEK_SET);
+        written = written && fwrite(records[i]->data(), 1, records[i]->size(), m_file) == records[i]->size();
+    }
+    written = written && sync();
+    // Header entries that may have reached the disk, a failed write may
+    // still have landed
+    unsigned int switched = 0;
+    for (unsigned int i = 0; i < indices.size() && written; i++) {
+        switched++;
+        uint8_t bytes[8];
+        put32(&bytes[0], entries[i].sector);
+        put32(&bytes[4], entries[i].size);
+        fseek(m_file, 8 + indices[i]*8, SEEK_SET);
+        written = fwrite(bytes, 1, sizeof(bytes), m_file) == sizeof(bytes);
+    }
+    written = written && sync();
+    if (!written) {
+        // Columns whose header entry may have switched keep both their old
+        // and new sectors until the file is opened again, so neither can be
+        // reused while the header on disk might still point at it. Only the
+        // new sectors of columns that were never switched are freed.
+        std::cout << "Could not write " << indices.size() << " columns of " << m_path << std::endl;
+        for (unsigned int i = 0; i < indices.size(); i++) {
+            if (i < switched) {
+                m_table[indices[i]] = entries[i];
+            }
+            else {
+                markSectors(entries[i], false);
+            }
+        }
+        return false;
+    }
+    for (unsigned int i = 0; i < indices.size(); i++) {
+        if (m_table[indices[i]].sector != 0) {
+            markSectors(m_table[indices[i]], false);
+        }
+        m_table[indices[i]] = entries[i];
+    }
+    return true;
+}
+
+// Flush buffered writes and wait until they reach the disk
+bool RegionFile::sync() {
+    if (fflush(m_file) != 0) {
+        return false;
+    }
+#if defined(_WIN32)
+    return _commit(_fileno(m_file)) == 0;
+#else
+    return fsync(fileno(m_file)) == 0;
+#endif
+}
+
+// Indices of the columns saved in the file
+void RegionFile::GetColumns(std::vector<int>& indices) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (int i = 0; i < REGION_COLUMNS; i++) {
+        if (m_table[i].sector != 0) {
+            indices.push_back(i);
+        }
+    }
+}
+
+// First run of count free sectors, growing the file if there is none
+uint32_t RegionFile::allocate(uint32_t count) {
+    uint32_t run = 0;
+    for (uint32_t i = REGION_HEADER_SECTORS; i < m_usedSectors.size(); i++) {
+        run = m_usedSectors[i] ? 0 : run + 1;
+        if (run == count) {
+            Entry entry = {i + 1 - count, count * REGION_SECTOR_SIZE};
+            markSectors(entry, true);
+            return entry.sector;
+        }
+    }
+    // Free sectors at the end of the file are reused before growing it
+    Entry entry = {(uint32_t) m_usedSectors.size() - run, count * REGION_SECTOR_SIZE};
+    m_usedSectors.resize(entry.sector + count, false);
+    markSectors(entry, true);
+    return entry.sector;
+}
+
+// Mark the sectors of a record used or free
+void RegionFile::markSectors(const Entry& entry, bool used) {
+    uint32_t end = entry.sector + sectorsFor(entry.size);
+    for (uint32_t i = entry.sector; i < end; i++) {
+        m_usedSectors[i] = used;
+    }
+}
+
+// Serialize the sections of a column, see RegionStore
+// Sections of air are left out, a section missing on load is air.
+static void serializeColumn(const BlocksArray& blocksArray, int chunkX, int chunkZ, std::vector<uint8_t>& out) {
+    out.assign(1, 0);
+    int layers = (blocksArray.height + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    for (int layer = 0; layer < layers; layer++) {
+        const Chunk* chunk = blocksArray.findChunk((ChunkCoord) {chunkX, layer, chunkZ});
+        if (chunk == nullptr || (chunk->bitsPerBlock == 0 && chunk->palette[0] == Empty)) {
+            continue;
+        }
+        out[0]++;
+        out.push_back(layer);
+        out.push_back(chunk->bitsPerBlock);
+        out.push_back(chunk->palette.size() - 1);
+        out.insert(out.end(), chunk->palette.begin(), chunk->palette.end());
+        for (uint64_t word : chunk->indices) {
+            for (int i = 0; i < 8; i++) {
+                out.push_back((word >> (i * 8)) & 0xff);
+            }
+        }
+    }
+}
+
+// Rebuild the sections of a serialized column, rejecting anything a
+// valid section could not hold
+static bool deserializeColumn(const std::vector<uint8_t>& data, int layers, GeneratedColumn& column) {
+    column.layers.clear();
+    column.layers.resize(layers);
+    if (data.empty()) {
+        return false;
+    }
+    std::size_t in = 1;
+    for (int section = 0; section < data[0]; section++) {
+        if (data.size() - in < 3) {
+            return false;
+        }
+        int layer = data[in];
+        uint8_t bits = data[in + 1];
+        unsigned int paletteSize = data[in + 2] + 1u;
+        in += 3;
+        if (layer >= layers || column.layers[layer] ||
+            (bits != 0 && bits != 1 && bits != 2 && bits != 4 && bits != 8) || paletteSize > (1u << bits)) {
+            return false;
+        }
+        std::size_t words = CHUNK_VOLUME * bits / 64;
+        if (data.size() - in < paletteSize + words * 8) {
+            return false;
+        }
+        std::unique_ptr<Chunk> chunk(new Chunk());
+        chunk->palette.assign(data.begin() + in, data.begin() + in + paletteSize);
+        in += paletteSize;
+        for (uint8_t blockType : chunk->palette) {
+            if (blockType > Empty) {
+                return false;
+            }
+        }
+        chunk->bitsPerBlock = bits;
+        chunk->indices.resize(words);
+        for (std::size_t word = 0; word < words; word++) {
+            uint64_t value = 0;
+            for (int i = 0; i < 8; i++) {
+                value |= (uint64_t) data[in + i] << (i * 8);
+            }
+            chunk->indices[word] = value;
+            in += 8;
+        }
+        if (bits > 0) {
+            for (int i = 0; i < CHUNK_VOLUME; i++) {
+                unsigned int bit = i * bits;
+                if (((chunk->indices[bit >> 6] >> (bit & 63)) & ((1u << bits) - 1)) >= paletteSize) {
+                    return false;
+                }
+            }
+        }
+        chunk->rebuildSolid();
+        column.layers[layer] = std::move(chunk);
+    }
+    return in == data.size();
+}
+
+RegionStore::RegionStore(const std::string& directory, int worldHeight) : m_directory(directory) {
+    m_worldHeight = worldHeight;
+    m_stats = {0, 0, 0, 0, 0.0, 0.0};
+}
+
+RegionStore::~RegionStore() {}
+
+// Create the directory if needed
+bool RegionStore::Open() {
+    std::error_code error;
+    std::filesystem::create_directories(m_directory, error);
+    if (error) {
+        std::cout << "Could not create world directory " << m_directory << ": " << error.message() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Region file containing a column, opened on first use
+RegionFile* RegionStore::regionOf(int chunkX, int chunkZ, bool create) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ChunkCoord key = {chunkX >> REGION_SHIFT, 0, chunkZ >> REGION_SHIFT};
+    auto it = m_regions.find(key);
+    if (it != m_regions.end()) {
+        return it->second.get();
+    }
+    std::string path = m_directory + "/r." + std::to_string(key.x) + "." + std::to_string(key.z) + ".mcr";
+    if (!create && !std::filesystem::exists(path)) {
+        return nullptr;
+    }
+    std::unique_ptr<RegionFile> region(new RegionFile(path));
+    if (!region->Open()) {
+        return nullptr;
+    }
+    RegionFile* opened = region.get();
+    m_regions[key] = std::move(region);
+    return opened;
+}
+
+// Fill column with the saved sections of column.chunkX, column.chunkZ
+bool RegionStore::LoadColumn(GeneratedColumn& column) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    RegionFile* region = regionOf(column.chunkX, column.chunkZ, false);
+    int index = (column.chunkX & (REGION_SIZE - 1)) + (column.chunkZ & (REGION_SIZE - 1)) * REGION_SIZE;
+    std::vector<uint8_t> record;
+    if (region == nullptr || !region->Read(index, record)) {
+        return false;
+    }
+    int layers = (m_worldHeight + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    // Largest serialized column: every section 8 bits wide with a full palette
+    std::size_t maxSize = 1 + (std::size_t) layers * (3 + 256 + CHUNK_VOLUME);
+    std::vector<uint8_t> data;
+    bool valid = record.size() >= 4 && get32(&record[0]) <= maxSize;
+    if (valid) {
+        data.resize(get32(&record[0]));
+        valid = DecompressLZ4(&record[4], record.size() - 4, data.data(), data.size()) &&
+            deserializeColumn(data, layers, column);
+    }
+    if (!valid) {
+        std::cout << "Corrupt saved column " << column.chunkX << ", " << column.chunkZ << " ignored" << std::endl;
+        column.layers.clear();
+        return false;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.columnsLoaded++;
+    m_stats.loadSeconds += seconds;
+    return true;
+}
+
+// Serialize and compress a column of the world into a record
+// Only reads the world, so columns can be encoded on several threads
+// while the world is not changing.
+void RegionStore::EncodeColumn(const BlocksArray& blocksArray, int chunkX, int chunkZ, std::vector<uint8_t>& record) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::vector<uint8_t> data;
+    serializeColumn(blocksArray, chunkX, chunkZ, data);
+    std::vector<uint8_t> compressed;
+    CompressLZ4(data.data(), data.size(), compressed);
+    record.resize(4);
+    put32(&record[0], data.size());
+    record.insert(record.end(), compressed.begin(), compressed.end());
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.rawBytes += data.size();
+    m_stats.saveSeconds += seconds;
+}
+
+// Write the records of columns, a batch per region file
+// Returns false if any region could not be written, the others are saved.
+bool RegionStore::WriteColumns(const std::vector<ChunkCoord>& columns, const std::vector<std::vector<uint8_t>>& records) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    // Columns of each region, by index into columns
+    std::unordered_map<ChunkCoord, std::vector<int>, ChunkCoordHash> regions;
+    for (unsigned int i = 0; i < columns.size(); i++) {
+        regions[(ChunkCoord) {columns[i].x >> REGION_SHIFT, 0, columns[i].z >> REGION_SHIFT}].push_back(i);
+    }
+    bool written = true;
+    unsigned int columnsSaved = 0;
+    std::size_t bytes = 0;
+    for (const auto& entry : regions) {
+        RegionFile* region = regionOf(entry.first.x * REGION_SIZE, entry.first.z * REGION_SIZE, true);
+        std::vector<int> indices;
+        std::vector<const std::vector<uint8_t>*> regionRecords;
+        for (int i : entry.second) {
+            indices.push_back((columns[i].x & (REGION_SIZE - 1)) + (columns[i].z & (REGION_SIZE - 1)) * REGION_SIZE);
+            regionRecords.push_back(&records[i]);
+        }
+        if (region == nullptr || !region->Write(indices, regionRecords)) {
+            written = false;
+            continue;
+        }
+        columnsSaved += indices.size();
+        for (const std::vector<uint8_t>* record : regionRecords) {
+            bytes += record->size();
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.columnsSaved += columnsSaved;
+    m_stats.compressedBytes += bytes;
+    m_stats.saveSeconds += seconds;
+    return written;
+}
+
+// Columns saved in every region file of the directory, keyed with y = 0
+void RegionStore::ListColumns(std::vector<ChunkCoord>& columns) {
+    std::error_code error;
+    for (const auto& file : std::filesystem::directory_iterator(m_directory, error)) {
+        int regionX;
+        int regionZ;
+        char extension[4];
+        std::string name = file.path().filename().string();
+        if (sscanf(name.c_str(), "r.%d.%d.%3s", &regionX, &regionZ, extension) != 3 || strcmp(extension, "mcr") != 0) {
+            continue;
+        }
+        RegionFile* region = regionOf(regionX * REGION_SIZE, regionZ * REGION_SIZE, false);
+        if (region == nullptr) {
+            continue;
+        }
+        std::vector<int> indices;
+        region->GetColumns(indices);
+        for (int index : indices) {
+            columns.push_back((ChunkCoord) {regionX * REGION_SIZE + index % REGION_SIZE, 0, regionZ * REGION_SIZE + index / REGION_SIZE});
+        }
+    }
+}
+
+const std::string& RegionStore::GetDirectory() const {
+    return m_directory;
+}
+
+RegionStats RegionStore::GetStats() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
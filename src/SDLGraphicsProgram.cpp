@@ -1,18 +1,28 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
 #include <iostream>
 #include <string>
 #include <sstream>
 #include <fstream>
+#include <cmath>
 
 #include "SDLGraphicsProgram.hpp"
 #include "Camera.hpp"
-#include "SelectionFrameBuffer.hpp"
 #include "Image.hpp"
+#include "Raycast.hpp"
+#include "HeightmapImporter.hpp"
+#include "Profiler.hpp"
 
 
 // Initialization function
 // Returns a true or false value based on successful completion of setup.
 // Takes in dimensions of window.
-SDLGraphicsProgram::SDLGraphicsProgram(int w, int h):m_screenWidth(w),m_screenHeight(h){
+SDLGraphicsProgram::SDLGraphicsProgram(int w, int h, const WorldSettings& world, const DisplaySettings& display):m_screenWidth(w),m_screenHeight(h),m_display(display){
+    m_startTime = std::chrono::steady_clock::now();
+    Profiler::Instance().SetThreadName("Main");
 	// Initialization flag
 	bool success = true;
 	// String to hold any errors that occur.
@@ -21,6 +31,13 @@ SDLGraphicsProgram::SDLGraphicsProgram(int w, int h):m_screenWidth(w),m_screenHe
 	m_window = NULL;
 	// Render flag
 
+#if defined(LINUX)
+	// Without a display use SDL's offscreen video driver, which needs no
+	// window system, unless another driver was asked for
+	if (m_display.headless && getenv("DISPLAY") == NULL && getenv("WAYLAND_DISPLAY") == NULL) {
+		SDL_setenv("SDL_VIDEODRIVER", "offscreen", 0);
+	}
+#endif
 	// Initialize SDL
 	if (SDL_Init(SDL_INIT_VIDEO) < 0) {
 		errorStream << "SDL could not initialize! SDL Error: " << SDL_GetError() << "\n";
@@ -41,7 +58,7 @@ SDLGraphicsProgram::SDLGraphicsProgram(int w, int h):m_screenWidth(w),m_screenHe
                                 SDL_WINDOWPOS_UNDEFINED,
                                 m_screenWidth,
                                 m_screenHeight,
-                                SDL_WINDOW_OPENGL | SDL_WINDOW_SHOWN );
+                                SDL_WINDOW_OPENGL | (m_display.headless ? SDL_WINDOW_HIDDEN : SDL_WINDOW_SHOWN) );
 
 		// Check if Window did not create.
 		if (m_window == NULL ) {
@@ -67,6 +84,19 @@ SDLGraphicsProgram::SDLGraphicsProgram(int w, int h):m_screenWidth(w),m_screenHe
 			errorStream << "Unable to initialize OpenGL!\n";
 			success = false;
 		}
+
+		if (m_display.headless) {
+			offscreen.reset(new FrameBuffer());
+			if (!offscreen->Create(m_screenWidth, m_screenHeight)) {
+				errorStream << "Unable to create the offscreen framebuffer!\n";
+				success = false;
+			}
+			std::error_code error;
+			if (!m_display.dumpDirectory.empty() && !std::filesystem::create_directories(m_display.dumpDirectory, error) && error) {
+				errorStream << "Unable to create frame dump directory " << m_display.dumpDirectory << "!\n";
+				success = false;
+			}
+		}
   	}
 
     // If initialization did not work, then print out a list of errors in the constructor.
@@ -80,14 +110,22 @@ SDLGraphicsProgram::SDLGraphicsProgram(int w, int h):m_screenWidth(w),m_screenHe
 
 	// SDL_LogSetAllPriority(SDL_LOG_PRIORITY_WARN); // Uncomment to enable extra debug support!
 	GetOpenGLVersionInfo();
-    SDL_SetRelativeMouseMode(SDL_bool::SDL_TRUE);
+    if (!m_display.headless) {
+        SDL_SetRelativeMouseMode(SDL_bool::SDL_TRUE);
+    }
 
+    // Field of view, aspect ratio, near and far clipping plane.
+    // Note I cannot see anything closer than 0.1f units from the screen.
+    // The far plane moves out with a view distance beyond it.
+    float farPlane = std::max(150.0f, (float) world.viewDistance * CHUNK_SIZE);
+    Camera::Instance().SetProjection(45.0f, (float) m_screenWidth / (float) m_screenHeight, 0.1f, farPlane);
+    cameraUniforms.Create();
     builder.InitializeBlockData("texture_atlas_original.png");
+    builder.SetJobSystem(&jobs);
+    streamer.SetJobSystem(&jobs);
     crosshair.MakeTexturedQuad(m_screenWidth, m_screenHeight);
-    InitWorld();
+    InitWorld(world);
     activeBlock = Brick;
-
-    selectionBuffer.Create(m_screenWidth, m_screenHeight);
 }
 
 
@@ -119,53 +157,204 @@ bool SDLGraphicsProgram::InitGL() {
 }
 
 // Initialize world terrain
-void SDLGraphicsProgram::InitWorld() {
-    Image heightMap("terrain_height.ppm");
-    heightMap.LoadPPM(true);
-    int height = 0;
-    for (int x = 0; x < WIDTH; x++) {
-        for (int z = 0; z < DEPTH; z++) {
-            height = ((float) heightMap.GetPixelR(x, z) / 255.0f) * HEIGHT;
-            if (height < HEIGHT) {
-                blocksArray.getBlock(x, height, z).isVisible = true;
-                // Set block at heightmap value to snow or grass based on elevation
-                if (height > 36) {
-                    blocksArray.getBlock(x, height, z).blockType = Snow;
-                }
-                else {
-                    blocksArray.getBlock(x, height, z).blockType = Grass;
-                }
-                // Set column of blocks below heightmap value to dirt
-                for (int y = 0; y < height; y++) {
-                    blocksArray.getBlock(x, y, z).isVisible = true;
-                    blocksArray.getBlock(x, y, z).blockType = Dirt;
-                }
+// The terrain is generated from the seed, or a heightmap tiled across
+// the world if one is given. The columns around the camera are loaded
+// before the first frame, the rest streams in as the camera moves. An
+// imported heightmap is kept whole in memory, or streamed from the region
+// files like any other world when it is saved.
+void SDLGraphicsProgram::InitWorld(const WorldSettings& world) {
+    PROFILE_SCOPE("SDLGraphicsProgram::InitWorld");
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    Camera& camera = Camera::Instance();
+    glm::vec3 eye(camera.GetEyeXPosition(), camera.GetEyeYPosition(), camera.GetEyeZPosition());
+    streamer.SetViewRadius(world.viewDistance, STREAM_HYSTERESIS);
+    if (!world.save.empty()) {
+        store.reset(new RegionStore(world.save, blocksArray.height));
+        if (!store->Open()) {
+            exit(1);
+        }
+        saver.reset(new WorldSaver(store.get()));
+        saver->SetInterval(world.autosaveInterval);
+        streamer.SetSaver(saver.get());
+    }
+    // A snapshot replaces building the world, and keeps the camera where it was
+    snapshotPath = world.snapshot;
+    bool restored = !snapshotPath.empty() && WorldSnapshot(snapshotPath).Load(blocksArray, &jobs, eye);
+    if (!world.import.empty()) {
+        if (!restored) {
+            importWorld(world.import);
+        }
+        // A saved import streams in from its region files, air around it
+        if (store) {
+            terrain.reset(new EmptyTerrain(blocksArray.height));
+        }
+    }
+    else {
+        if (world.heightmap.empty()) {
+            std::cout << "Terrain: seed " << world.seed << ", " << FractalNoise::GetSimdPath() << " noise" << std::endl;
+            terrain.reset(new NoiseTerrain(world.seed, blocksArray.height));
+        }
+        else {
+            std::unique_ptr<Image> heightMap(new Image(world.heightmap));
+            if (!heightMap->Load(true)) {
+                exit(1);
             }
+            terrain.reset(new HeightmapTerrain(std::move(heightMap), blocksArray.height));
+        }
+    }
+    if (terrain) {
+        streamer.SetGenerator(terrain.get());
+        if (restored) {
+            streamer.AdoptColumns(blocksArray);
+        }
+        else {
+            streamer.LoadAround(blocksArray, eye);
+        }
+    }
+    if (restored) {
+        camera.SetEyePosition(eye);
+    }
+    else {
+        // Start standing on the terrain instead of buried in it
+        int ground = blocksArray.height - 1;
+        while (ground >= 0 && !blocksArray.isSolidBlock((int) std::floor(eye.x), ground, (int) std::floor(eye.z))) {
+            ground--;
+        }
+        camera.SetEyePosition(glm::vec3(eye.x, ground + 2.0f, eye.z));
+        if (!snapshotPath.empty()) {
+            WorldSnapshot(snapshotPath).Save(blocksArray, glm::vec3(eye.x, ground + 2.0f, eye.z));
         }
     }
+    SectionStats sections = blocksArray.sectionStats();
+    std::cout << "World: " << sections.sections << " chunks, "
+        << sections.bytes / 1024 << " KB, "
+        << (sections.sections > 0 ? sections.bytes / sections.sections : 0) << " bytes per section" << std::endl;
+    std::cout << "Sections by index width: uniform " << sections.sectionsByBits[0]
+        << ", 1 bit " << sections.sectionsByBits[1]
+        << ", 2 bit " << sections.sectionsByBits[2]
+        << ", 4 bit " << sections.sectionsByBits[3]
+        << ", 8 bit " << sections.sectionsByBits[4] << std::endl;
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "World ready in " << seconds * 1000.0 << " ms on " << jobs.GetWorkerCount() + 1 << " threads" << std::endl;
+}
+
 
-    // Hide all surrounded blocks
-    for (int x = 0; x < WIDTH; x++) {
-        for (int y = 0; y < HEIGHT; y++) {
-            for (int z = 0; z < DEPTH; z++) {
-                BlockData& currBlock = blocksArray.getBlock(x, y, z);
-                if (blocksArray.isSurrounded(x, y, z)) {
-                    currBlock.isVisible = false;
+// Import a heightmap as the world, tile by tile
+// With a region store every wave of tiles is saved and dropped as soon
+// as it is filled, and the world streams back in around the camera, so
+// memory stays bounded by a wave however large the map is. A store that
+// already holds the world is streamed from without importing again.
+// Without a store the whole world stays in memory, so maps of more than
+// IMPORT_MAX_RESIDENT_COLUMNS chunk columns are refused.
+void SDLGraphicsProgram::importWorld(const std::string& path) {
+    PROFILE_SCOPE("SDLGraphicsProgram::importWorld");
+    if (store) {
+        std::vector<ChunkCoord> saved;
+        store->ListColumns(saved);
+        if (!saved.empty()) {
+            std::cout << "Streaming " << saved.size() << " saved columns from " << store->GetDirectory() << std::endl;
+            return;
+        }
+    }
+    Image heightMap(path);
+    if (!heightMap.Load(true)) {
+        exit(1);
+    }
+    std::size_t columnCount = (std::size_t) ((heightMap.GetWidth() + CHUNK_SIZE - 1) / CHUNK_SIZE) *
+        ((heightMap.GetHeight() + CHUNK_SIZE - 1) / CHUNK_SIZE);
+    if (!store && columnCount > IMPORT_MAX_RESIDENT_COLUMNS) {
+        std::cout << "A " << heightMap.GetWidth() << "x" << heightMap.GetHeight() << " heightmap is " << columnCount
+            << " chunk columns, more than the " << IMPORT_MAX_RESIDENT_COLUMNS << " kept in memory."
+            << " Import it with --save <directory> to stream it from region files." << std::endl;
+        exit(1);
+    }
+    RegionStats before = {0, 0, 0, 0, 0.0, 0.0};
+    if (store) {
+        before = store->GetStats();
+    }
+    int layers = (blocksArray.height + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    HeightmapImporter importer(heightMap, blocksArray.height);
+    importer.SetJobSystem(&jobs);
+    const ImportStats& stats = importer.Import([this, layers](std::vector<GeneratedColumn>& wave) {
+        std::vector<ChunkCoord> columns;
+        for (GeneratedColumn& column : wave) {
+            for (int layer = 0; layer < (int) column.layers.size(); layer++) {
+                if (column.layers[layer]) {
+                    ChunkCoord coord = {column.chunkX, layer, column.chunkZ};
+                    blocksArray.chunks[coord] = std::move(column.layers[layer]);
                 }
             }
+            columns.push_back((ChunkCoord) {column.chunkX, 0, column.chunkZ});
         }
+        if (store) {
+            // Nothing has seen these chunks yet, so they are dropped
+            // without going through removeChunk
+            saveColumns(columns);
+            for (const ChunkCoord& column : columns) {
+                for (int layer = 0; layer < layers; layer++) {
+                    blocksArray.chunks.erase((ChunkCoord) {column.x, layer, column.z});
+                }
+            }
+        }
+    });
+    std::cout << "Imported " << heightMap.GetWidth() << "x" << heightMap.GetHeight() << " heightmap: "
+        << stats.tiles << " tiles, " << stats.columns << " columns in " << stats.seconds * 1000.0 << " ms, "
+        << stats.tilesInFlight << " tiles in flight" << std::endl;
+    if (store) {
+        RegionStats after = store->GetStats();
+        std::cout << "Saved " << after.columnsSaved - before.columnsSaved << " columns to " << store->GetDirectory() << ": "
+            << (after.rawBytes - before.rawBytes) / 1024 << " KB compressed to "
+            << (after.compressedBytes - before.compressedBytes) / 1024 << " KB in "
+            << (after.saveSeconds - before.saveSeconds) * 1000.0 << " ms of worker time" << std::endl;
+        return;
     }
+    // Find the exposed faces of all blocks, chunk by chunk across the workers
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::vector<ChunkCoord> coords;
+    for (auto& entry : blocksArray.chunks) {
+        coords.push_back(entry.first);
+    }
+    std::vector<char> changed;
+    ComputeFaceMasks(blocksArray, coords, &jobs, changed);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Face masks of " << coords.size() << " chunks in " << seconds * 1000.0 << " ms" << std::endl;
+}
+
+// Save columns of the world, encoded across the workers
+// Encoding only reads the world, which does not change meanwhile.
+void SDLGraphicsProgram::saveColumns(const std::vector<ChunkCoord>& columns) {
+    PROFILE_SCOPE("SDLGraphicsProgram::saveColumns");
+    std::vector<std::vector<uint8_t>> records(columns.size());
+    jobs.ParallelFor(columns.size(), [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            store->EncodeColumn(blocksArray, columns[i].x, columns[i].z, records[i]);
+        }
+    });
+    store->WriteColumns(columns, records);
 }
 
 
 // Update OpenGL
-void SDLGraphicsProgram::Update() {}
+void SDLGraphicsProgram::Update() {
+    PROFILE_SCOPE("SDLGraphicsProgram::Update");
+    Camera& camera = Camera::Instance();
+    glm::vec3 eye(camera.GetEyeXPosition(), camera.GetEyeYPosition(), camera.GetEyeZPosition());
+    glm::vec3 direction(camera.GetViewXDirection(), camera.GetViewYDirection(), camera.GetViewZDirection());
+    streamer.Update(blocksArray, eye, direction);
+    if (saver) {
+        saver->Update(blocksArray);
+    }
+}
 
 
 
 // Render
 // The render function gets called once per loop
 void SDLGraphicsProgram::Render() {
+    PROFILE_SCOPE("SDLGraphicsProgram::Render");
+    if (offscreen) {
+        offscreen->Bind();
+    }
     // Set background to sky color
     glViewport(0, 0, m_screenWidth, m_screenHeight);
     glClearColor(135.0f/255.0f, 206.0f/255.0f, 235.0f/255.0f, 1.f);
@@ -175,6 +364,9 @@ void SDLGraphicsProgram::Render() {
     // and we have to do this every frame!
   	glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
 
+    // View and projection are shared by every block drawn this frame
+    Camera::Instance().UpdateFrustum();
+    cameraUniforms.Update(Camera::Instance());
     crosshair.Render(); // Render crosshair
     builder.Render(blocksArray); // Render blocks
 }
@@ -187,13 +379,33 @@ void SDLGraphicsProgram::Loop() {
     bool quit = false;
 	bool showWireframe = false;
     float cameraSpeed = 1.0f;
+    bool firstFrameShown = false;
+    unsigned int frame = 0;
     // Event handler that handles various events in SDL
     // that are related to input and output
     SDL_Event e;
     // Enable text input
-    SDL_StartTextInput();
+    if (!m_display.headless) {
+        SDL_StartTextInput();
+    }
     // While application is running
     while (!quit) {
+        Profiler::Instance().MarkFrame();
+        PROFILE_SCOPE("Frame");
+        std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
+        if (m_display.frames > 0 && frame >= m_display.frames) {
+            break;
+        }
+        if (benchmark && !benchmark->BeginFrame(frame)) {
+            break;
+        }
+        if (m_display.headless && !benchmark) {
+            // Only closing the window gets through
+            SDL_PumpEvents();
+            SDL_FlushEvents(SDL_KEYDOWN, SDL_MOUSEWHEEL);
+        }
+        {
+        PROFILE_SCOPE("Events");
      	 //Handle events on queue
 		while (SDL_PollEvent( &e ) != 0) {
         	// User posts an event to quit
@@ -201,6 +413,9 @@ void SDLGraphicsProgram::Loop() {
     	    if (e.type == SDL_QUIT) {
         		quit = true;
 	        }
+            if (recording) {
+                recording->Record(frame, e);
+            }
             if (e.type == SDL_MOUSEMOTION) {
                 int mouseX = e.motion.x;
                 int mouseY = e.motion.y;
@@ -212,12 +427,10 @@ void SDLGraphicsProgram::Loop() {
                 int mouseY = e.motion.y;
                     // std::cout << "Mouse X: " << mouseX << " Y: " << mouseY << std::endl;
                 if (e.button.button == SDL_BUTTON_LEFT) {
-                    MakeSelection(m_screenWidth/2, m_screenHeight/2, SDL_BUTTON_LEFT);
-                    // MakeSelection(mouseX, mouseY, SDL_BUTTON_LEFT);
+                    MakeSelection(SDL_BUTTON_LEFT);
                 }
                 else if (e.button.button == SDL_BUTTON_RIGHT) {
-                    MakeSelection(m_screenWidth/2, m_screenHeight/2, SDL_BUTTON_RIGHT);
-                    // MakeSelection(mouseX, mouseY, SDL_BUTTON_RIGHT);
+                    MakeSelection(SDL_BUTTON_RIGHT);
                 }
             }
 			if (e.type == SDL_KEYDOWN) {
@@ -260,14 +473,20 @@ void SDLGraphicsProgram::Loop() {
                         << Camera::Instance().GetEyeZPosition() << " "
                         << std::endl;
                         {
-                            int x = Camera::Instance().GetEyeXPosition();
-                            int y = Camera::Instance().GetEyeYPosition();
-                            int z = Camera::Instance().GetEyeZPosition();
-                            if (blocksArray.isValidBlock(x, y, z) && blocksArray.getBlock(x, y, z).isVisible) {
+                            int x = (int) std::floor(Camera::Instance().GetEyeXPosition() + 0.5f);
+                            int y = (int) std::floor(Camera::Instance().GetEyeYPosition() + 0.5f);
+                            int z = (int) std::floor(Camera::Instance().GetEyeZPosition() + 0.5f);
+                            if (blocksArray.isVisibleBlock(x, y, z)) {
                                 std::cout << "Inside block" << std::endl;
                             }
                         }
                         break;
+                    case SDLK_o:
+                        Profiler::Instance().PrintSummary();
+                        break;
+                    case SDLK_t:
+                        Profiler::Instance().WriteTrace("trace.json");
+                        break;
                     case SDLK_c:
                         Camera::Instance().ToggleCollision();
                         break;
@@ -277,6 +496,42 @@ void SDLGraphicsProgram::Loop() {
                     case SDLK_r:
                         builder.ReloadShaders();
                         break;
+                    case SDLK_m:
+                        builder.ToggleRenderMode();
+                        break;
+                    case SDLK_f:
+                        {
+                            const RenderStats& stats = builder.GetRenderStats();
+                            std::cout << "Chunks: " << stats.chunksTested << " tested, "
+                                << stats.chunksCulled << " culled, "
+                                << stats.chunksDrawn << " drawn" << std::endl;
+                            const StreamStats& streamStats = streamer.GetStats();
+                            std::cout << "Streaming: " << streamStats.loadedColumns << " columns loaded, "
+                                << streamStats.pendingColumns << " generating, "
+                                << streamStats.columnsLoaded << " loaded and "
+                                << streamStats.columnsUnloaded << " unloaded in total, "
+                                << blocksArray.chunks.size() << " chunks, "
+                                << blocksArray.memoryUsage() / 1024 << " KB" << std::endl;
+                            if (streamStats.generationSeconds > 0.0) {
+                                std::cout << "Generation: " << streamStats.columnsGenerated << " columns, "
+                                    << streamStats.columnsGenerated / streamStats.generationSeconds
+                                    << " columns per second per worker" << std::endl;
+                            }
+                            if (store) {
+                                RegionStats storeStats = store->GetStats();
+                                SaveStats saveStats = saver->GetStats();
+                                std::cout << "Saves: " << storeStats.columnsLoaded << " columns loaded in "
+                                    << storeStats.loadSeconds * 1000.0 << " ms, " << storeStats.columnsSaved << " saved in "
+                                    << storeStats.saveSeconds * 1000.0 << " ms, " << blocksArray.unsavedColumns.size()
+                                    << " columns unsaved" << std::endl;
+                                std::cout << "Autosave: " << saveStats.autosaves << " saves, "
+                                    << saveStats.columnsSaved << " columns, " << saveStats.queuedColumns << " queued, "
+                                    << (saveStats.writeSeconds > 0.0 ? saveStats.bytesWritten / saveStats.writeSeconds / 1024.0 : 0.0)
+                                    << " KB/s, pause " << saveStats.lastPauseSeconds * 1000.0 << " ms last, "
+                                    << saveStats.maxPauseSeconds * 1000.0 << " ms max" << std::endl;
+                            }
+                        }
+                        break;
                     case SDLK_1:
                         activeBlock = Dirt;
                         break;
@@ -307,46 +562,111 @@ void SDLGraphicsProgram::Loop() {
 				}
 			}
       	} // End SDL_PollEvent loop.
+        }
 
 		// Update our scene
 		Update();
 		// Render using OpenGL
 	    Render();
       	//Update screen of our specified window
-      	SDL_GL_SwapWindow(GetSDLWindow());
+        if (!m_display.headless) {
+            PROFILE_SCOPE("SDL_GL_SwapWindow");
+      	    SDL_GL_SwapWindow(GetSDLWindow());
+        }
+        if (!firstFrameShown) {
+            firstFrameShown = true;
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_startTime).count();
+            std::cout << "First frame after " << seconds * 1000.0 << " ms" << std::endl;
+        }
+        if (benchmark || m_display.headless) {
+            // Wait for the GPU so the frame is measured until it is drawn
+            glFinish();
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - frameStart).count();
+            const RenderStats& stats = builder.GetRenderStats();
+            if (benchmark) {
+                benchmark->EndFrame(seconds, stats);
+            }
+            if (m_display.headless) {
+                std::cout << "Frame " << frame << ": " << seconds * 1000.0 << " ms, " << stats.drawCalls
+                    << " draw calls, " << stats.triangles << " triangles" << std::endl;
+                if (!m_display.dumpDirectory.empty() && frame % m_display.dumpInterval == 0) {
+                    dumpFrame(frame);
+                }
+            }
+        }
+        if (benchmark) {
+            // Let the workers finish what the frame started
+            std::chrono::steady_clock::time_point waitStart = std::chrono::steady_clock::now();
+            jobs.Wait();
+            benchmark->EndWorkerWait(std::chrono::duration<double>(std::chrono::steady_clock::now() - waitStart).count());
+        }
+        frame++;
     }
 
     //Disable text input
-    SDL_StopTextInput();
+    if (!m_display.headless) {
+        SDL_StopTextInput();
+    }
+    if (benchmark) {
+        BenchmarkMemory memory = {blocksArray.memoryUsage(), builder.GetMeshMemory()};
+        benchmark->Report((const char*) glGetString(GL_RENDERER), jobs.GetWorkerCount() + 1, memory);
+    }
+    if (recording) {
+        recording->SetLength(frame);
+        recording->Save(recordingPath);
+    }
+    if (saver) {
+        saver->Flush(blocksArray);
+        SaveStats stats = saver->GetStats();
+        std::cout << "Saved " << stats.columnsSaved << " columns in " << stats.autosaves << " saves" << std::endl;
+    }
+    if (!snapshotPath.empty()) {
+        Camera& camera = Camera::Instance();
+        WorldSnapshot(snapshotPath).Save(blocksArray,
+            glm::vec3(camera.GetEyeXPosition(), camera.GetEyeYPosition(), camera.GetEyeZPosition()));
+    }
+}
+
+// Frames are named by number, so a dump of the same run replaces the last one
+void SDLGraphicsProgram::dumpFrame(unsigned int frame) {
+    std::vector<uint8_t> pixels;
+    offscreen->ReadPixels(pixels);
+    char name[32];
+    snprintf(name, sizeof(name), "frame_%05u.png", frame);
+    WritePNG(m_display.dumpDirectory + "/" + name, m_screenWidth, m_screenHeight, pixels.data());
+}
+
+// Frames run as fast as they can, without waiting for vertical sync
+void SDLGraphicsProgram::SetBenchmark(const InputScript& script, const std::string& reportPath) {
+    benchmark.reset(new Benchmark(script, reportPath));
+    SDL_GL_SetSwapInterval(0);
+}
+
+void SDLGraphicsProgram::SetRecording(const std::string& path) {
+    recording.reset(new InputScript());
+    recordingPath = path;
 }
 
-// Get selected block from selection frame buffer
+// Get the block under the crosshair by casting a ray from the camera
 // Handle block destroy or placement
-void SDLGraphicsProgram::MakeSelection(int mouseX, int mouseY, int clickType) {
-    // Render blocks in selection framebuffer
-    selectionBuffer.Render(blocksArray, m_screenWidth, m_screenHeight);
-
-    // Read pixel color from framebuffer and convert back to block index
-    int selectedBlockIndex = selectionBuffer.ReadPixel(mouseX, m_screenHeight - mouseY - 1) - 1;
-    selectionBuffer.Unbind();
-    if (selectedBlockIndex == -1) {
+void SDLGraphicsProgram::MakeSelection(int clickType) {
+    PROFILE_SCOPE("SDLGraphicsProgram::MakeSelection");
+    Camera& camera = Camera::Instance();
+    glm::vec3 eye(camera.GetEyeXPosition(), camera.GetEyeYPosition(), camera.GetEyeZPosition());
+    glm::vec3 direction(camera.GetViewXDirection(), camera.GetViewYDirection(), camera.GetViewZDirection());
+    RaycastHit hit;
+    // Same reach as the default far clipping plane
+    if (!RaycastBlocks(blocksArray, eye, direction, 150.0f, hit)) {
         return;
     }
-    int face = selectedBlockIndex % 6; // 0 - 5 face of block
-    int blockID = selectedBlockIndex - face; //  block starting index
-    selectedBlockIndex = blockID / 6; // x y z conversion
-
-    int z = selectedBlockIndex % DEPTH;
-    int y = (selectedBlockIndex % (DEPTH * HEIGHT)) / DEPTH;
-    int x = selectedBlockIndex / (DEPTH * HEIGHT);
-    // std::cout << "Selected index: " << selectedBlockIndex << std::endl;
-    // std::cout << "Block ID: " << blockID << std::endl;
+    int face = hit.face; // 0 - 5 face of block
+    int x = hit.x;
+    int y = hit.y;
+    int z = hit.z;
     // std::cout << "Face: " << face << std::endl;
     if (clickType == SDL_BUTTON_LEFT) {
-        // std::cout << "Selected index: " << selectedBlockIndex << std::endl;
-        blocksArray.getBlock(x, y, z).isVisible = false;
-        blocksArray.getBlock(x, y, z).blockType = Empty;
-        blocksArray.revealSurroundingBlocks(x, y, z);
+        blocksArray.setBlockType(x, y, z, Empty);
+        blocksArray.updateFaceMasksAround(x, y, z);
     }
     // debug face selection
     if (clickType == SDL_BUTTON_RIGHT) {
@@ -377,9 +697,8 @@ void SDLGraphicsProgram::MakeSelection(int mouseX, int mouseY, int clickType) {
         if (blocksArray.isValidBlock(x, y, z)) {
             // std::cout << "Placing on Block X: " << x << " Y: " << y << " Z: " << z << std::endl;
             // std::cout << "Block type is: " << blocksArray.getBlock(x, y, z).blockType << std::endl;
-            blocksArray.getBlock(x, y, z).blockType = activeBlock;
-            blocksArray.getBlock(x, y, z).isVisible = true;
-            blocksArray.hideSurroundingBlocks(x, y, z);
+            blocksArray.setBlockType(x, y, z, activeBlock);
+            blocksArray.updateFaceMasksAround(x, y, z);
         }
         else {
             // std::cout << "Out of bounds block" << std::endl;
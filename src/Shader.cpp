@@ -4,7 +4,9 @@
 #include <fstream>
 
 // Constructor
-Shader::Shader(){}
+Shader::Shader(){
+    m_shaderID = 0;
+}
 
 // Destructor
 Shader::~Shader(){
@@ -76,7 +78,43 @@ void Shader::CreateShader(const std::string& vertexShaderSource, const std::stri
         Log("CreateShader","ERROR, shader did not link! Were there compile errors in the shader?");
     }
 
+    // Replace the program of an earlier CreateShader (e.g. on reload)
+    glDeleteProgram(m_shaderID);
     m_shaderID = program;
+    CacheUniformLocations();
+}
+
+// Uniform locations only change when the program is linked, so
+// resolve them all once here instead of on every Set call
+void Shader::CacheUniformLocations(){
+    m_uniformLocations.clear();
+    GLint count = 0;
+    GLint maxLength = 0;
+    glGetProgramiv(m_shaderID, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(m_shaderID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::string name(maxLength, '\0');
+    for(GLint i = 0; i < count; i++){
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(m_shaderID, i, maxLength, &length, &size, &type, &name[0]);
+        std::string uniformName = name.substr(0, length);
+        GLint location = glGetUniformLocation(m_shaderID, uniformName.c_str());
+        // Uniforms inside blocks have no location
+        if(location == -1){
+            continue;
+        }
+        m_uniformLocations[uniformName] = location;
+        // Arrays are reported as 'name[0]' but set by their plain name
+        if(uniformName.size() > 3 && uniformName.compare(uniformName.size() - 3, 3, "[0]") == 0){
+            m_uniformLocations[uniformName.substr(0, uniformName.size() - 3)] = location;
+        }
+    }
+}
+
+GLint Shader::GetUniformLocation(const GLchar* name) const{
+    auto it = m_uniformLocations.find(name);
+    return it == m_uniformLocations.end() ? -1 : it->second;
 }
 
 
@@ -148,12 +186,22 @@ GLuint Shader::GetID() const{
     return m_shaderID;
 }
 
+// Point a uniform block of this program at a uniform buffer binding
+void Shader::BindUniformBlock(const GLchar* name, GLuint binding){
+    GLuint index = glGetUniformBlockIndex(m_shaderID, name);
+    if(index == GL_INVALID_INDEX){
+        Log("BindUniformBlock", "uniform block not found");
+        return;
+    }
+    glUniformBlockBinding(m_shaderID, index, binding);
+}
+
 
 // Set our uniforms for our shader.
 void Shader::SetUniformMatrix4fv(const GLchar* name, const GLfloat* value){
     // Note that we are now 'looking' inside the shader for a particular
     // variable. This means the name has to exactly match!
-    GLint location = glGetUniformLocation(m_shaderID,name);
+    GLint location = GetUniformLocation(name);
 
     // Now update this information through our uniforms.
     // glUniformMatrix4v means a 4x4 matrix of floats
@@ -163,24 +211,30 @@ void Shader::SetUniformMatrix4fv(const GLchar* name, const GLfloat* value){
 
 // Sets 1 int value in our uniform (That is why the suffix is 1i).
 void Shader::SetUniformMatrix1i(const GLchar* name, int value){
-    GLint location = glGetUniformLocation(m_shaderID,name);
+    GLint location = GetUniformLocation(name);
     glUniform1i(location, value);
 }
 
 // Set 4 float values
 void Shader::SetUniform4f(const GLchar* name, float v0, float v1, float v2, float v3){
-    GLint location = glGetUniformLocation(m_shaderID, name);
+    GLint location = GetUniformLocation(name);
     glUniform4f(location, v0, v1, v2, v3);
 }
 
 // Sets 1 float value in our uniform (That is why the suffix is 1f).
 void Shader::SetUniform1f(const GLchar* name, float value){
-    GLint location = glGetUniformLocation(m_shaderID,name);
+    GLint location = GetUniformLocation(name);
     glUniform1f(location, value);
 }
 
 // Set our uniforms for our shader (Useful for a vec3).
 void Shader::SetUniform3f(const GLchar* name, float v0, float v1, float v2){
-    GLint location = glGetUniformLocation(m_shaderID,name);
+    GLint location = GetUniformLocation(name);
     glUniform3f(location, v0, v1, v2);
 }
+
+// Set an array of uvec2 uniforms, values holds 2 * count unsigned ints
+void Shader::SetUniform2uiv(const GLchar* name, int count, const GLuint* values){
+    GLint location = GetUniformLocation(name);
+    glUniform2uiv(location, count, values);
+}
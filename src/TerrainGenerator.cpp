@@ -0,0 +1,136 @@
+#include <algorithm>
+#include <cmath>
+
+#include "TerrainGenerator.hpp"
+
+// Build the chunk columns covered by a tile and fill them up to the tile heights
+// Chunks are allocated on the first block written into them.
+void FillTerrainTile(const HeightTile& tile, int worldHeight, std::vector<GeneratedColumn>& columns) {
+    int firstChunkX = tile.x >> CHUNK_SHIFT;
+    int firstChunkZ = tile.z >> CHUNK_SHIFT;
+    int lastChunkX = (tile.x + tile.width - 1) >> CHUNK_SHIFT;
+    int lastChunkZ = (tile.z + tile.depth - 1) >> CHUNK_SHIFT;
+    int chunksZ = lastChunkZ - firstChunkZ + 1;
+    std::size_t first = columns.size();
+    for (int chunkX = firstChunkX; chunkX <= lastChunkX; chunkX++) {
+        for (int chunkZ = firstChunkZ; chunkZ <= lastChunkZ; chunkZ++) {
+            columns.emplace_back();
+            columns.back().chunkX = chunkX;
+            columns.back().chunkZ = chunkZ;
+        }
+    }
+    int layers = (worldHeight + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    for (int i = 0; i < tile.width; i++) {
+        for (int j = 0; j < tile.depth; j++) {
+            int height = tile.heights[i*tile.depth + j];
+            if (height >= worldHeight) {
+                continue;
+            }
+            int x = tile.x + i;
+            int z = tile.z + j;
+            GeneratedColumn& column = columns[first + ((x >> CHUNK_SHIFT) - firstChunkX) * chunksZ + ((z >> CHUNK_SHIFT) - firstChunkZ)];
+            if (column.layers.empty()) {
+                column.layers.resize(layers);
+            }
+            for (int y = 0; y <= height; y++) {
+                std::unique_ptr<Chunk>& chunk = column.layers[y >> CHUNK_SHIFT];
+                if (!chunk) {
+                    chunk.reset(new Chunk());
+                }
+                // Set block at heightmap value to snow or grass based on elevation
+                // and the blocks below it to dirt
+                uint8_t blockType = Dirt;
+                if (y == height) {
+                    blockType = height > 36 ? Snow : Grass;
+                }
+                chunk->setBlockType(x & (CHUNK_SIZE - 1), y & (CHUNK_SIZE - 1), z & (CHUNK_SIZE - 1), blockType);
+            }
+        }
+    }
+    // Shrink the palettes, buried chunks become uniform
+    for (std::size_t c = first; c < columns.size(); c++) {
+        for (std::unique_ptr<Chunk>& chunk : columns[c].layers) {
+            if (chunk) {
+                chunk->compact();
+            }
+        }
+    }
+}
+
+TerrainGenerator::TerrainGenerator(int worldHeight) {
+    m_worldHeight = worldHeight;
+}
+
+TerrainGenerator::~TerrainGenerator() {}
+
+// Fill column from a tile covering exactly that chunk column
+void TerrainGenerator::fillFromTile(const HeightTile& tile, GeneratedColumn& column) const {
+    std::vector<GeneratedColumn> columns;
+    FillTerrainTile(tile, m_worldHeight, columns);
+    column.layers = std::move(columns[0].layers);
+}
+
+// Takes a loaded image
+HeightmapTerrain::HeightmapTerrain(std::unique_ptr<Image> image, int worldHeight)
+    : TerrainGenerator(worldHeight), m_image(std::move(image)) {}
+
+HeightmapTerrain::~HeightmapTerrain() {}
+
+// Every other copy of the image is mirrored, so neighboring copies
+// meet at matching edges
+void HeightmapTerrain::GenerateColumn(GeneratedColumn& column) const {
+    int width = m_image->GetWidth();
+    int depth = m_image->GetHeight();
+    int periodX = 2 * width;
+    int periodZ = 2 * depth;
+    HeightTile tile = {column.chunkX*CHUNK_SIZE, column.chunkZ*CHUNK_SIZE, CHUNK_SIZE, CHUNK_SIZE,
+        std::vector<int>(CHUNK_SIZE * CHUNK_SIZE)};
+    for (int i = 0; i < CHUNK_SIZE; i++) {
+        int x = (((tile.x + i) % periodX) + periodX) % periodX;
+        if (x >= width) {
+            x = periodX - 1 - x;
+        }
+        for (int j = 0; j < CHUNK_SIZE; j++) {
+            int z = (((tile.z + j) % periodZ) + periodZ) % periodZ;
+            if (z >= depth) {
+                z = periodZ - 1 - z;
+            }
+            tile.heights[i*CHUNK_SIZE + j] = ((float) m_image->GetSample(x, z, 0) / m_image->GetMaxValue()) * m_worldHeight;
+        }
+    }
+    fillFromTile(tile, column);
+}
+
+// Five octaves, the broadest hills spanning about 128 blocks
+NoiseTerrain::NoiseTerrain(uint32_t seed, int worldHeight)
+    : TerrainGenerator(worldHeight), m_noise(seed, 5, 1.0f / 128.0f, 2.0f, 0.5f) {}
+
+NoiseTerrain::~NoiseTerrain() {}
+
+// The heights of the whole column are sampled as one batch
+void NoiseTerrain::GenerateColumn(GeneratedColumn& column) const {
+    float x[CHUNK_SIZE * CHUNK_SIZE];
+    float z[CHUNK_SIZE * CHUNK_SIZE];
+    float noise[CHUNK_SIZE * CHUNK_SIZE];
+    for (int i = 0; i < CHUNK_SIZE * CHUNK_SIZE; i++) {
+        x[i] = column.chunkX*CHUNK_SIZE + i / CHUNK_SIZE;
+        z[i] = column.chunkZ*CHUNK_SIZE + i % CHUNK_SIZE;
+    }
+    m_noise.Sample(x, z, CHUNK_SIZE * CHUNK_SIZE, noise);
+    HeightTile tile = {column.chunkX*CHUNK_SIZE, column.chunkZ*CHUNK_SIZE, CHUNK_SIZE, CHUNK_SIZE,
+        std::vector<int>(CHUNK_SIZE * CHUNK_SIZE)};
+    for (int i = 0; i < CHUNK_SIZE * CHUNK_SIZE; i++) {
+        int height = (int) std::floor(NOISE_TERRAIN_BASE + NOISE_TERRAIN_AMPLITUDE * noise[i]);
+        tile.heights[i] = std::max(0, std::min(height, m_worldHeight - 1));
+    }
+    fillFromTile(tile, column);
+}
+
+EmptyTerrain::EmptyTerrain(int worldHeight) : TerrainGenerator(worldHeight) {}
+
+EmptyTerrain::~EmptyTerrain() {}
+
+void EmptyTerrain::GenerateColumn(GeneratedColumn& column) const {
+    column.layers.clear();
+    column.layers.resize((m_worldHeight + CHUNK_SIZE - 1) / CHUNK_SIZE);
+}
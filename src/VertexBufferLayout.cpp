@@ -11,6 +11,8 @@ VertexBufferLayout::~VertexBufferLayout(){
     glDeleteBuffers(1, &m_vertexPositionBuffer);
     glDeleteBuffers(1, &m_textureCoordinatesBuffer);
     glDeleteBuffers(1, &m_indexBufferObject);
+    glDeleteBuffers(1, &m_instanceBuffer);
+    glDeleteVertexArrays(1, &m_VAOId);
 }
 
 
@@ -185,3 +187,54 @@ void VertexBufferLayout::CreateTextureBufferLayout(unsigned int vcount, unsigned
         glBufferData(GL_ELEMENT_ARRAY_BUFFER, icount*sizeof(unsigned int), idata,GL_STATIC_DRAW);
     }
 
+
+void VertexBufferLayout::CreateChunkBufferLayout(unsigned int vcount, unsigned int icount, const unsigned int* vdata, const unsigned int* idata){
+        // This layout packs a vertex into two unsigned ints
+        m_stride = 2;
+
+        // Only generate our objects the first time, after that
+        // we just replace the data they hold.
+        if(m_VAOId == 0){
+            glGenVertexArrays(1, &m_VAOId);
+            glBindVertexArray(m_VAOId);
+
+            glGenBuffers(1, &m_vertexPositionBuffer);
+            glBindBuffer(GL_ARRAY_BUFFER, m_vertexPositionBuffer);
+
+            // Integer attributes need the 'I' variant so they
+            // reach the shader as a uvec2 instead of being converted to floats
+            glEnableVertexAttribArray(0);
+            glVertexAttribIPointer(0, 2, GL_UNSIGNED_INT, sizeof(unsigned int)*m_stride, 0);
+
+            glGenBuffers(1, &m_indexBufferObject);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBufferObject);
+        }else{
+            glBindVertexArray(m_VAOId);
+            glBindBuffer(GL_ARRAY_BUFFER, m_vertexPositionBuffer);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBufferObject);
+        }
+
+        glBufferData(GL_ARRAY_BUFFER, vcount*sizeof(unsigned int), vdata, GL_STATIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, icount*sizeof(unsigned int), idata, GL_STATIC_DRAW);
+    }
+
+
+void VertexBufferLayout::SetInstanceData(unsigned int count, const int* data){
+        glBindVertexArray(m_VAOId);
+        if(m_instanceBuffer == 0){
+            glGenBuffers(1, &m_instanceBuffer);
+            glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+            glEnableVertexAttribArray(3);
+            glVertexAttribIPointer(3, 4, GL_INT, sizeof(int)*4, 0);
+            // Advance once per instance instead of once per vertex
+            glVertexAttribDivisor(3, 1);
+        }else{
+            glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+        }
+        glBufferData(GL_ARRAY_BUFFER, count*sizeof(int), data, GL_DYNAMIC_DRAW);
+    }
+
+void VertexBufferLayout::SetFirstInstance(unsigned int first){
+        glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+        glVertexAttribIPointer(3, 4, GL_INT, sizeof(int)*4, (char*)(first*sizeof(int)*4));
+    }
@@ -0,0 +1,184 @@
+#include "WorldSaver.hpp"
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <vector>
+
+WorldSaver::WorldSaver(RegionStore* store) {
+    m_store = store;
+    m_interval = AUTOSAVE_INTERVAL;
+    m_lastSave = std::chrono::steady_clock::now();
+    m_writing = 0;
+    m_stop = false;
+    m_stats = {0, 0, 0, 0.0, 0.0, 0.0, 0};
+    m_thread = std::thread(&WorldSaver::saverLoop, this);
+}
+
+// Write every queued column and stop the saver thread
+WorldSaver::~WorldSaver() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_queued.notify_one();
+    m_thread.join();
+}
+
+// Seconds between autosaves, 0 saves only on unload and Flush
+void WorldSaver::SetInterval(double seconds) {
+    m_interval = seconds;
+}
+
+// Per frame: snapshot the edited columns once the interval has passed
+void WorldSaver::Update(BlocksArray& blocksArray) {
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (m_interval <= 0.0 || std::chrono::duration<double>(now - m_lastSave).count() < m_interval) {
+        return;
+    }
+    m_lastSave = now;
+    PROFILE_SCOPE("WorldSaver::snapshotEdited");
+    snapshotEdited(blocksArray);
+}
+
+// Snapshot one column to be written, for columns about to be unloaded
+void WorldSaver::SaveColumn(const BlocksArray& blocksArray, const ChunkCoord& column) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        queueSnapshot(blocksArray, column);
+    }
+    m_queued.notify_one();
+}
+
+// Snapshot every edited column and wait until all are written
+void WorldSaver::Flush(BlocksArray& blocksArray) {
+    snapshotEdited(blocksArray);
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_written.wait(lock, [this] { return m_queue.empty() && m_writing == 0; });
+}
+
+// Fill column from a queued snapshot or the store, safe from any thread
+bool WorldSaver::LoadColumn(GeneratedColumn& column) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_snapshots.find((ChunkCoord) {column.chunkX, 0, column.chunkZ});
+        if (it != m_snapshots.end()) {
+            const BlocksArray& blocks = it->second->blocks;
+            int layers = (blocks.height + CHUNK_SIZE - 1) / CHUNK_SIZE;
+            column.layers.clear();
+            column.layers.resize(layers);
+            for (int layer = 0; layer < layers; layer++) {
+                const Chunk* chunk = blocks.findChunk((ChunkCoord) {column.chunkX, layer, column.chunkZ});
+                if (chunk != nullptr) {
+                    column.layers[layer].reset(new Chunk(*chunk));
+                    column.layers[layer]->rebuildSolid();
+                }
+            }
+            return true;
+        }
+    }
+    return m_store->LoadColumn(column);
+}
+
+SaveStats WorldSaver::GetStats() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.queuedColumns = m_queue.size() + m_writing;
+    return m_stats;
+}
+
+// Snapshot the columns of the world edited since the last save
+// This is the whole cost of an autosave on the main thread.
+void WorldSaver::snapshotEdited(BlocksArray& blocksArray) {
+    if (blocksArray.unsavedColumns.empty()) {
+        return;
+    }
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const ChunkCoord& column : blocksArray.unsavedColumns) {
+            queueSnapshot(blocksArray, column);
+        }
+        blocksArray.unsavedColumns.clear();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        m_stats.autosaves++;
+        m_stats.lastPauseSeconds = seconds;
+        m_stats.maxPauseSeconds = std::max(m_stats.maxPauseSeconds, seconds);
+    }
+    m_queued.notify_one();
+}
+
+// Copy a column and queue it, m_mutex must be held
+// Only the palette and indices are copied, which is all encoding needs.
+// A column still waiting in the queue gets its snapshot replaced.
+void WorldSaver::queueSnapshot(const BlocksArray& blocksArray, const ChunkCoord& column) {
+    std::shared_ptr<ColumnSnapshot> snapshot(new ColumnSnapshot());
+    snapshot->column = column;
+    snapshot->blocks.height = blocksArray.height;
+    snapshot->taken = false;
+    int layers = (blocksArray.height + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    for (int layer = 0; layer < layers; layer++) {
+        ChunkCoord coord = {column.x, layer, column.z};
+        const Chunk* chunk = blocksArray.findChunk(coord);
+        if (chunk != nullptr) {
+            std::unique_ptr<Chunk> copy(new Chunk());
+            copy->palette = chunk->palette;
+            copy->bitsPerBlock = chunk->bitsPerBlock;
+            copy->indices = chunk->indices;
+            snapshot->blocks.chunks[coord] = std::move(copy);
+        }
+    }
+    std::shared_ptr<ColumnSnapshot>& slot = m_snapshots[column];
+    if (!slot || slot->taken) {
+        m_queue.push_back(column);
+    }
+    slot = snapshot;
+}
+
+// Body of the saver thread
+// Takes every queued column at once, encodes and writes them as one
+// batch, then drops the snapshots that were not replaced meanwhile.
+void WorldSaver::saverLoop() {
+    Profiler::Instance().SetThreadName("Saver");
+    while (true) {
+        std::vector<std::shared_ptr<ColumnSnapshot>> batch;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_queued.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+            if (m_queue.empty()) {
+                return;
+            }
+            for (const ChunkCoord& column : m_queue) {
+                std::shared_ptr<ColumnSnapshot>& snapshot = m_snapshots[column];
+                snapshot->taken = true;
+                batch.push_back(snapshot);
+            }
+            m_queue.clear();
+            m_writing = batch.size();
+        }
+        PROFILE_SCOPE("WorldSaver::writeBatch");
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        std::vector<ChunkCoord> columns;
+        std::vector<std::vector<uint8_t>> records(batch.size());
+        std::size_t bytes = 0;
+        for (unsigned int i = 0; i < batch.size(); i++) {
+            columns.push_back(batch[i]->column);
+            m_store->EncodeColumn(batch[i]->blocks, batch[i]->column.x, batch[i]->column.z, records[i]);
+            bytes += records[i].size();
+        }
+        m_store->WriteColumns(columns, records);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (const std::shared_ptr<ColumnSnapshot>& snapshot : batch) {
+                auto it = m_snapshots.find(snapshot->column);
+                if (it != m_snapshots.end() && it->second == snapshot) {
+                    m_snapshots.erase(it);
+                }
+            }
+            m_writing = 0;
+            m_stats.columnsSaved += batch.size();
+            m_stats.bytesWritten += bytes;
+            m_stats.writeSeconds += seconds;
+        }
+        m_written.notify_all();
+    }
+}
@@ -0,0 +1,268 @@
+#include "WorldSnapshot.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <vector>
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Written as 0x01020304, reads differently on a machine of the other byte order
+#define SNAPSHOT_BYTE_ORDER 0x01020304u
+
+// Chunk flags of a directory entry
+#define SNAPSHOT_SOLID 1
+#define SNAPSHOT_FACE_MASKS 2
+
+struct SnapshotHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t height;
+    uint64_t chunkCount;
+    uint64_t fileSize;
+    float eye[3];
+    uint32_t reserved;
+};
+static_assert(sizeof(SnapshotHeader) == 48, "the snapshot header must keep its layout");
+
+struct SnapshotEntry {
+    int32_t x;
+    int32_t y;
+    int32_t z;
+    uint8_t bitsPerBlock;
+    // Palette size - 1
+    uint8_t paletteSize;
+    uint8_t flags;
+    uint8_t reserved;
+    // From the start of the file
+    uint64_t offset;
+};
+static_assert(sizeof(SnapshotEntry) == 24, "snapshot entries must keep their layout");
+
+static const char SNAPSHOT_MAGIC[4] = {'M', 'C', 'S', 'N'};
+
+static std::size_t align8(std::size_t bytes) {
+    return (bytes + 7) & ~(std::size_t) 7;
+}
+
+// Bytes of the data of a chunk
+static std::size_t chunkBytes(unsigned int paletteSize, unsigned int bitsPerBlock, uint8_t flags) {
+    return align8(paletteSize) + CHUNK_VOLUME * bitsPerBlock / 8 +
+        ((flags & SNAPSHOT_SOLID) ? CHUNK_SIZE * CHUNK_SIZE * sizeof(ChunkColumn) : 0) +
+        ((flags & SNAPSHOT_FACE_MASKS) ? CHUNK_VOLUME : 0);
+}
+
+// Build a chunk from its entry, rejecting anything a section could not hold
+static bool loadChunk(const uint8_t* data, std::size_t size, const SnapshotEntry& entry, std::unique_ptr<Chunk>& chunk) {
+    unsigned int bits = entry.bitsPerBlock;
+    unsigned int paletteSize = entry.paletteSize + 1u;
+    if ((bits != 0 && bits != 1 && bits != 2 && bits != 4 && bits != 8) || paletteSize > (1u << bits) ||
+        ((entry.flags & SNAPSHOT_SOLID) != 0) != (bits > 0) || entry.offset % 8 != 0 || entry.offset > size ||
+        chunkBytes(paletteSize, bits, entry.flags) > size - entry.offset) {
+        return false;
+    }
+    const uint8_t* in = data + entry.offset;
+    for (unsigned int i = 0; i < paletteSize; i++) {
+        if (in[i] > Empty) {
+            return false;
+        }
+    }
+    chunk.reset(new Chunk());
+    chunk->palette.assign(in, in + paletteSize);
+    in += align8(paletteSize);
+    chunk->bitsPerBlock = bits;
+    chunk->indices.resize(CHUNK_VOLUME * bits / 64);
+    memcpy(chunk->indices.data(), in, chunk->indices.size() * sizeof(uint64_t));
+    in += chunk->indices.size() * sizeof(uint64_t);
+    // Indices past the palette are only possible when it is not full
+    if (bits > 0 && paletteSize < (1u << bits)) {
+        for (int i = 0; i < CHUNK_VOLUME; i++) {
+            unsigned int bit = i * bits;
+            if (((chunk->indices[bit >> 6] >> (bit & 63)) & ((1u << bits) - 1)) >= paletteSize) {
+                return false;
+            }
+        }
+    }
+    if (entry.flags & SNAPSHOT_SOLID) {
+        chunk->solid.resize(CHUNK_SIZE * CHUNK_SIZE);
+        memcpy(chunk->solid.data(), in, chunk->solid.size() * sizeof(ChunkColumn));
+        in += chunk->solid.size() * sizeof(ChunkColumn);
+    }
+    if (entry.flags & SNAPSHOT_FACE_MASKS) {
+        chunk->faceMasks.assign(in, in + CHUNK_VOLUME);
+    }
+    return true;
+}
+
+WorldSnapshot::WorldSnapshot(const std::string& path) : m_path(path) {}
+
+WorldSnapshot::~WorldSnapshot() {}
+
+bool WorldSnapshot::Load(BlocksArray& blocksArray, JobSystem* jobs, glm::vec3& eye) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    const uint8_t* data = nullptr;
+    std::size_t size = 0;
+#if defined(_WIN32)
+    std::vector<uint8_t> file;
+    FILE* input = fopen(m_path.c_str(), "rb");
+    if (input != NULL) {
+        fseek(input, 0, SEEK_END);
+        long length = ftell(input);
+        fseek(input, 0, SEEK_SET);
+        if (length > 0) {
+            file.resize(length);
+            size = fread(file.data(), 1, file.size(), input);
+        }
+        fclose(input);
+    }
+    data = file.data();
+#else
+    void* mapping = nullptr;
+    int fd = open(m_path.c_str(), O_RDONLY);
+    struct stat info;
+    if (fd >= 0 && fstat(fd, &info) == 0 && info.st_size > 0) {
+        mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping != MAP_FAILED) {
+            data = (const uint8_t*) mapping;
+            size = info.st_size;
+        }
+        else {
+            mapping = nullptr;
+        }
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+#endif
+    if (size == 0) {
+        return false;
+    }
+
+    SnapshotHeader header;
+    bool valid = size >= sizeof(header);
+    if (valid) {
+        memcpy(&header, data, sizeof(header));
+        valid = memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) == 0 &&
+            header.version == SNAPSHOT_VERSION && header.byteOrder == SNAPSHOT_BYTE_ORDER &&
+            header.fileSize == size && header.chunkCount <= (size - sizeof(header)) / sizeof(SnapshotEntry);
+    }
+    if (!valid) {
+        std::cout << m_path << " is not a snapshot of version " << SNAPSHOT_VERSION << ", ignored" << std::endl;
+    }
+    else if ( (int) header.height != blocksArray.height) {
+        std::cout << "Snapshot " << m_path << " is of a world " << header.height << " blocks high, ignored" << std::endl;
+        valid = false;
+    }
+    std::vector<std::unique_ptr<Chunk>> chunks;
+    const SnapshotEntry* entries = (const SnapshotEntry*) (data + sizeof(header));
+    if (valid) {
+        // Sections are checked and copied on every thread, the world is
+        // only touched once all of them passed
+        chunks.resize(header.chunkCount);
+        std::atomic<bool> chunksValid{true};
+        auto loadRange = [&](int begin, int end) {
+            for (int i = begin; i < end; i++) {
+                if (!loadChunk(data, size, entries[i], chunks[i])) {
+                    chunksValid = false;
+                }
+            }
+        };
+        if (jobs != nullptr) {
+            jobs->ParallelFor(chunks.size(), loadRange);
+        }
+        else {
+            loadRange(0, chunks.size());
+        }
+        valid = chunksValid;
+        if (!valid) {
+            std::cout << "Snapshot " << m_path << " is corrupt, ignored" << std::endl;
+        }
+    }
+    if (valid) {
+        blocksArray.chunks.reserve(blocksArray.chunks.size() + chunks.size());
+        for (unsigned int i = 0; i < chunks.size(); i++) {
+            ChunkCoord coord = {entries[i].x, entries[i].y, entries[i].z};
+            blocksArray.chunks[coord] = std::move(chunks[i]);
+        }
+        eye = glm::vec3(header.eye[0], header.eye[1], header.eye[2]);
+    }
+#if !defined(_WIN32)
+    if (mapping != nullptr) {
+        munmap(mapping, size);
+    }
+#endif
+    if (valid) {
+        double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Loaded snapshot " << m_path << ": " << chunks.size() << " chunks, "
+            << size / 1024 << " KB in " << milliseconds << " ms" << std::endl;
+    }
+    return valid;
+}
+
+bool WorldSnapshot::Save(const BlocksArray& blocksArray, const glm::vec3& eye) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::vector<const Chunk*> chunks;
+    std::vector<SnapshotEntry> entries;
+    std::size_t offset = align8(sizeof(SnapshotHeader) + blocksArray.chunks.size() * sizeof(SnapshotEntry));
+    for (const auto& entry : blocksArray.chunks) {
+        const Chunk& chunk = *entry.second;
+        uint8_t flags = (chunk.solid.empty() ? 0 : SNAPSHOT_SOLID) | (chunk.faceMasks.empty() ? 0 : SNAPSHOT_FACE_MASKS);
+        entries.push_back((SnapshotEntry) {entry.first.x, entry.first.y, entry.first.z, chunk.bitsPerBlock,
+            (uint8_t) (chunk.palette.size() - 1), flags, 0, offset});
+        chunks.push_back(&chunk);
+        offset += chunkBytes(chunk.palette.size(), chunk.bitsPerBlock, flags);
+    }
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header.version = SNAPSHOT_VERSION;
+    header.byteOrder = SNAPSHOT_BYTE_ORDER;
+    header.height = blocksArray.height;
+    header.chunkCount = entries.size();
+    header.fileSize = offset;
+    header.eye[0] = eye.x;
+    header.eye[1] = eye.y;
+    header.eye[2] = eye.z;
+
+    std::string temporary = m_path + ".tmp";
+    FILE* output = fopen(temporary.c_str(), "wb");
+    if (output == NULL) {
+        std::cout << "Could not write snapshot " << temporary << std::endl;
+        return false;
+    }
+    static const uint8_t padding[8] = {0};
+    bool written = fwrite(&header, sizeof(header), 1, output) == 1 &&
+        fwrite(entries.data(), sizeof(SnapshotEntry), entries.size(), output) == entries.size();
+    std::size_t position = sizeof(header) + entries.size() * sizeof(SnapshotEntry);
+    written = written && fwrite(padding, 1, align8(position) - position, output) == align8(position) - position;
+    for (unsigned int i = 0; i < chunks.size() && written; i++) {
+        const Chunk& chunk = *chunks[i];
+        written = fwrite(chunk.palette.data(), 1, chunk.palette.size(), output) == chunk.palette.size() &&
+            fwrite(padding, 1, align8(chunk.palette.size()) - chunk.palette.size(), output) == align8(chunk.palette.size()) - chunk.palette.size() &&
+            fwrite(chunk.indices.data(), sizeof(uint64_t), chunk.indices.size(), output) == chunk.indices.size() &&
+            fwrite(chunk.solid.data(), sizeof(ChunkColumn), chunk.solid.size(), output) == chunk.solid.size() &&
+            fwrite(chunk.faceMasks.data(), 1, chunk.faceMasks.size(), output) == chunk.faceMasks.size();
+    }
+    written = fclose(output) == 0 && written;
+#if defined(_WIN32)
+    // rename does not replace an existing file here
+    remove(m_path.c_str());
+#endif
+    if (!written || rename(temporary.c_str(), m_path.c_str()) != 0) {
+        std::cout << "Could not write snapshot " << m_path << std::endl;
+        remove(temporary.c_str());
+        return false;
+    }
+    double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Wrote snapshot " << m_path << ": " << chunks.size() << " chunks, "
+        << offset / 1024 << " KB in " << milliseconds << " ms" << std::endl;
+    return true;
+}
@@ -0,0 +1,286 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <utility>
+
+#include "WorldStreamer.hpp"
+#include "Profiler.hpp"
+
+WorldStreamer::WorldStreamer() {
+    m_generator = nullptr;
+    m_jobs = nullptr;
+    m_saver = nullptr;
+    m_radius = STREAM_RADIUS;
+    m_hysteresis = STREAM_HYSTERESIS;
+    m_stats = {0, 0, 0, 0, 0, 0.0};
+}
+
+WorldStreamer::~WorldStreamer() {}
+
+// Terrain of the columns loaded from now on, must outlive the streamer
+void WorldStreamer::SetGenerator(const TerrainGenerator* generator) {
+    m_generator = generator;
+}
+
+// Generate columns on the workers of jobs instead of the main thread
+void WorldStreamer::SetJobSystem(JobSystem* jobs) {
+    m_jobs = jobs;
+}
+
+// Load saved columns through saver instead of generating them, and
+// hand edited columns to it before they are unloaded
+void WorldStreamer::SetSaver(WorldSaver* saver) {
+    m_saver = saver;
+}
+
+void WorldStreamer::SetViewRadius(int radius, int hysteresis) {
+    m_radius = radius;
+    m_hysteresis = hysteresis;
+}
+
+// Distance in blocks from eye to the center of a column, on the x-z plane
+float WorldStreamer::columnDistance(const ChunkCoord& column, const glm::vec3& eye) const {
+    float dx = column.x*CHUNK_SIZE + CHUNK_SIZE / 2 - eye.x;
+    float dz = column.z*CHUNK_SIZE + CHUNK_SIZE / 2 - eye.z;
+    return std::sqrt(dx*dx + dz*dz);
+}
+
+// Start loading or generating a column
+// The generator only fills chunks owned by the job, the world is not
+// touched until the main thread adds the result.
+void WorldStreamer::requestColumn(const ChunkCoord& column) {
+    m_pendingColumns.insert(column);
+    const TerrainGenerator* generator = m_generator;
+    WorldSaver* saver = m_saver;
+    std::function<void()> job = [this, generator, saver, column]() {
+        PROFILE_SCOPE("WorldStreamer::loadColumn");
+        std::unique_ptr<GeneratedColumn> generated(new GeneratedColumn());
+        generated->chunkX = column.x;
+        generated->chunkZ = column.z;
+        if (saver != nullptr && saver->LoadColumn(*generated)) {
+            m_finishedColumns.Push(std::move(generated));
+            return;
+        }
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        generator->GenerateColumn(*generated);
+        m_generationNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        m_columnsGenerated++;
+        m_finishedColumns.Push(std::move(generated));
+    };
+    if (m_jobs != nullptr) {
+        m_jobs->Submit(std::move(job));
+    }
+    else {
+        job();
+    }
+}
+
+// Move the generated columns still in range into the world
+// A column the camera left behind while it was generated is dropped.
+void WorldStreamer::addColumns(BlocksArray& blocksArray, std::vector<std::unique_ptr<GeneratedColumn>>& columns, const glm::vec3& eye) {
+    std::vector<ChunkCoord> added;
+    for (std::unique_ptr<GeneratedColumn>& generated : columns) {
+        ChunkCoord column = {generated->chunkX, 0, generated->chunkZ};
+        m_pendingColumns.erase(column);
+        if (columnDistance(column, eye) > (m_radius + m_hysteresis) * CHUNK_SIZE) {
+            continue;
+        }
+        for (int layer = 0; layer < (int) generated->layers.size(); layer++) {
+            if (generated->layers[layer]) {
+                ChunkCoord coord = {column.x, layer, column.z};
+                blocksArray.chunks[coord] = std::move(generated->layers[layer]);
+                blocksArray.dirtyChunks.insert(coord);
+            }
+        }
+        m_loadedColumns.insert(column);
+        m_stats.columnsLoaded++;
+        added.push_back(column);
+    }
+    refreshColumns(blocksArray, added);
+}
+
+// Recompute the face masks of the loaded columns among columns and their neighbors
+// Faces on the border of a column change when the column next to it
+// is loaded or unloaded.
+void WorldStreamer::refreshColumns(BlocksArray& blocksArray, const std::vector<ChunkCoord>& columns) {
+    std::unordered_set<ChunkCoord, ChunkCoordHash> refresh;
+    for (const ChunkCoord& column : columns) {
+        refresh.insert(column);
+        for (int face = 0; face < NumFaces; face++) {
+            if (FACE_NORMALS[face][1] == 0) {
+                refresh.insert((ChunkCoord) {column.x + FACE_NORMALS[face][0], 0, column.z + FACE_NORMALS[face][2]});
+            }
+        }
+    }
+    std::vector<ChunkCoord> coords;
+    int layers = (blocksArray.height + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    for (const ChunkCoord& column : refresh) {
+        if (m_loadedColumns.count(column) == 0) {
+            continue;
+        }
+        for (int layer = 0; layer < layers; layer++) {
+            ChunkCoord coord = {column.x, layer, column.z};
+            if (blocksArray.findChunk(coord) != nullptr) {
+                coords.push_back(coord);
+            }
+        }
+    }
+    std::vector<char> changed;
+    ComputeFaceMasks(blocksArray, coords, m_jobs, changed);
+    for (unsigned int i = 0; i < coords.size(); i++) {
+        if (changed[i]) {
+            blocksArray.dirtyChunks.insert(coords[i]);
+        }
+    }
+}
+
+// Compute the face masks of the chunks at coords, spread across jobs
+// Only face masks are written while the pass runs, and each chunk is
+// written by one thread, so every thread reads the same occupancy.
+void ComputeFaceMasks(BlocksArray& blocksArray, const std::vector<ChunkCoord>& coords, JobSystem* jobs, std::vector<char>& changed) {
+    changed.assign(coords.size(), 0);
+    // Look the chunks up first, the chunk map is not modified by the pass
+    std::vector<Chunk*> chunks(coords.size());
+    for (unsigned int i = 0; i < coords.size(); i++) {
+        chunks[i] = blocksArray.findChunk(coords[i]);
+    }
+    auto computeRange = [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            changed[i] = blocksArray.computeFaceMasks(coords[i], *chunks[i]);
+        }
+    };
+    if (jobs != nullptr) {
+        jobs->ParallelFor(coords.size(), computeRange);
+    }
+    else {
+        computeRange(0, coords.size());
+    }
+}
+
+// Generate every missing column in range of eye and wait for them
+void WorldStreamer::LoadAround(BlocksArray& blocksArray, const glm::vec3& eye) {
+    if (m_generator == nullptr) {
+        return;
+    }
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    int eyeChunkX = (int) std::floor(eye.x) >> CHUNK_SHIFT;
+    int eyeChunkZ = (int) std::floor(eye.z) >> CHUNK_SHIFT;
+    for (int x = eyeChunkX - m_radius; x <= eyeChunkX + m_radius; x++) {
+        for (int z = eyeChunkZ - m_radius; z <= eyeChunkZ + m_radius; z++) {
+            ChunkCoord column = {x, 0, z};
+            if (columnDistance(column, eye) <= m_radius * CHUNK_SIZE &&
+                m_loadedColumns.count(column) == 0 && m_pendingColumns.count(column) == 0) {
+                requestColumn(column);
+            }
+        }
+    }
+    if (m_jobs != nullptr) {
+        m_jobs->Wait();
+    }
+    std::vector<std::unique_ptr<GeneratedColumn>> columns;
+    m_finishedColumns.PopAll(columns);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    addColumns(blocksArray, columns, eye);
+    if (!columns.empty()) {
+        std::cout << "Generated " << columns.size() << " columns in " << seconds * 1000.0 << " ms on "
+            << (m_jobs != nullptr ? m_jobs->GetWorkerCount() : 0) << " workers: "
+            << columns.size() / seconds << " columns per second" << std::endl;
+    }
+}
+
+// Start generating the missing columns nearest to eye, favoring the view direction
+// Distance is scaled from 1x for columns straight ahead up to 2x for
+// columns behind the camera, so what the player looks at fills in first.
+void WorldStreamer::requestMissingColumns(const glm::vec3& eye, const glm::vec3& viewDirection) {
+    int budget = std::min(GENERATION_REQUESTS_PER_FRAME, MAX_PENDING_COLUMNS - (int) m_pendingColumns.size());
+    if (budget <= 0) {
+        return;
+    }
+    float viewLength = std::sqrt(viewDirection.x*viewDirection.x + viewDirection.z*viewDirection.z);
+    int eyeChunkX = (int) std::floor(eye.x) >> CHUNK_SHIFT;
+    int eyeChunkZ = (int) std::floor(eye.z) >> CHUNK_SHIFT;
+    std::vector<std::pair<float, ChunkCoord>> missing;
+    for (int x = eyeChunkX - m_radius; x <= eyeChunkX + m_radius; x++) {
+        for (int z = eyeChunkZ - m_radius; z <= eyeChunkZ + m_radius; z++) {
+            ChunkCoord column = {x, 0, z};
+            float distance = columnDistance(column, eye);
+            if (distance > m_radius * CHUNK_SIZE ||
+                m_loadedColumns.count(column) != 0 || m_pendingColumns.count(column) != 0) {
+                continue;
+            }
+            float facing = 0.0f;
+            if (viewLength > 0.0f && distance > 0.0f) {
+                float dx = column.x*CHUNK_SIZE + CHUNK_SIZE / 2 - eye.x;
+                float dz = column.z*CHUNK_SIZE + CHUNK_SIZE / 2 - eye.z;
+                facing = (dx*viewDirection.x + dz*viewDirection.z) / (distance * viewLength);
+            }
+            missing.push_back(std::make_pair(distance * (1.5f - 0.5f * facing), column));
+        }
+    }
+    int count = std::min(budget, (int) missing.size());
+    std::partial_sort(missing.begin(), missing.begin() + count, missing.end(),
+        [](const std::pair<float, ChunkCoord>& a, const std::pair<float, ChunkCoord>& b) {
+            return a.first < b.first;
+        });
+    for (int i = 0; i < count; i++) {
+        requestColumn(missing[i].second);
+    }
+}
+
+// Unload the columns beyond the radius plus hysteresis
+void WorldStreamer::unloadDistantColumns(BlocksArray& blocksArray, const glm::vec3& eye) {
+    std::vector<ChunkCoord> removed;
+    for (const ChunkCoord& column : m_loadedColumns) {
+        if (columnDistance(column, eye) > (m_radius + m_hysteresis) * CHUNK_SIZE) {
+            removed.push_back(column);
+        }
+    }
+    if (removed.empty()) {
+        return;
+    }
+    int layers = (blocksArray.height + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    for (const ChunkCoord& column : removed) {
+        if (blocksArray.unsavedColumns.erase(column) > 0 && m_saver != nullptr) {
+            m_saver->SaveColumn(blocksArray, column);
+        }
+        m_loadedColumns.erase(column);
+        for (int layer = 0; layer < layers; layer++) {
+            blocksArray.removeChunk((ChunkCoord) {column.x, layer, column.z});
+        }
+        m_stats.columnsUnloaded++;
+    }
+    // Removed columns are no longer loaded, so this refreshes the
+    // borders of the columns next to them
+    refreshColumns(blocksArray, removed);
+}
+
+// Count the columns already in the world as loaded, for a world
+// restored from a snapshot
+void WorldStreamer::AdoptColumns(const BlocksArray& blocksArray) {
+    for (const auto& entry : blocksArray.chunks) {
+        m_loadedColumns.insert((ChunkCoord) {entry.first.x, 0, entry.first.z});
+    }
+}
+
+// Per frame: add generated columns, start generating missing ones
+// and unload the ones left behind
+void WorldStreamer::Update(BlocksArray& blocksArray, const glm::vec3& eye, const glm::vec3& viewDirection) {
+    if (m_generator == nullptr) {
+        return;
+    }
+    PROFILE_SCOPE("WorldStreamer::Update");
+    std::vector<std::unique_ptr<GeneratedColumn>> columns;
+    m_finishedColumns.PopAll(columns);
+    addColumns(blocksArray, columns, eye);
+    unloadDistantColumns(blocksArray, eye);
+    requestMissingColumns(eye, viewDirection);
+}
+
+const StreamStats& WorldStreamer::GetStats() {
+    m_stats.loadedColumns = m_loadedColumns.size();
+    m_stats.pendingColumns = m_pendingColumns.size();
+    m_stats.columnsGenerated = m_columnsGenerated;
+    m_stats.generationSeconds = m_generationNanoseconds / 1e9;
+    return m_stats;
+}
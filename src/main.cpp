@@ -2,13 +2,123 @@
 // Last Updated: 1/21/17
 // Please do not redistribute without asking permission.
 
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+
 // Functionality that we created
 #include "SDLGraphicsProgram.hpp"
 
 int main(int argc, char** argv) {
+	// Terrain options:
+	//   --seed <number>      seed of the generated terrain
+	//   --heightmap <file>   tile a heightmap instead, e.g. terrain_height.ppm
+	//   --import <file>      import a heightmap as a fixed world, streamed
+	//                        from the region files when saved with --save
+	//   --save <directory>   keep the world in region files there, edits
+	//                        are saved on exit and as columns unload
+	//   --autosave <seconds> time between background saves of edits,
+	//                        0 to turn them off (default 30)
+	//   --snapshot <file>    start from a flat snapshot of the world when
+	//                        it exists, and write one on exit
+	//   --view-distance <n>  chunk columns kept loaded around the camera
+	//                        (default 8)
+	// Benchmark options:
+	//   --benchmark          fly the built-in flight over the world, then
+	//                        print frame times, draw calls, triangles and
+	//                        memory as JSON and quit
+	//   --script <file>      benchmark by replaying a recorded input script
+	//   --report <file>      also write the benchmark JSON there
+	//   --record <file>      record the input of the session to a script
+	// Headless options:
+	//   --headless           render offscreen in a hidden window, ignore
+	//                        input and print the time of every frame
+	//   --frames <n>         quit after n frames (default 60 when headless
+	//                        and not benchmarking)
+	//   --dump <directory>   write headless frames there as PNG
+	//   --dump-every <n>     only write every nth frame
+	// Runs with the same world options replay identically. Autosave is
+	// off while benchmarking, and a saved world should be benchmarked from
+	// a copy since the edits of a run are saved.
+	WorldSettings world;
+	DisplaySettings display;
+	bool runBenchmark = false;
+	std::string script;
+	std::string report;
+	std::string record;
+	for (int i = 1; i < argc; i++) {
+		std::string option = argv[i];
+		if (option == "--benchmark") {
+			runBenchmark = true;
+			continue;
+		}
+		if (option == "--headless") {
+			display.headless = true;
+			continue;
+		}
+		if (i + 1 >= argc) {
+			break;
+		}
+		if (option == "--seed") {
+			world.seed = std::strtoul(argv[++i], nullptr, 10);
+		}
+		else if (option == "--heightmap") {
+			world.heightmap = argv[++i];
+		}
+		else if (option == "--import") {
+			world.import = argv[++i];
+		}
+		else if (option == "--save") {
+			world.save = argv[++i];
+		}
+		else if (option == "--autosave") {
+			world.autosaveInterval = std::strtod(argv[++i], nullptr);
+		}
+		else if (option == "--snapshot") {
+			world.snapshot = argv[++i];
+		}
+		else if (option == "--view-distance") {
+			world.viewDistance = std::max(1, std::atoi(argv[++i]));
+		}
+		else if (option == "--script") {
+			script = argv[++i];
+			runBenchmark = true;
+		}
+		else if (option == "--report") {
+			report = argv[++i];
+		}
+		else if (option == "--record") {
+			record = argv[++i];
+		}
+		else if (option == "--frames") {
+			display.frames = std::strtoul(argv[++i], nullptr, 10);
+		}
+		else if (option == "--dump") {
+			display.dumpDirectory = argv[++i];
+		}
+		else if (option == "--dump-every") {
+			display.dumpInterval = std::max(1ul, std::strtoul(argv[++i], nullptr, 10));
+		}
+	}
+	InputScript input = InputScript::Flight();
+	if (!script.empty() && !input.Load(script)) {
+		return 1;
+	}
+	if (runBenchmark) {
+		world.autosaveInterval = 0.0;
+	}
+	else if (display.headless && display.frames == 0) {
+		display.frames = 60;
+	}
 
 	// Create an instance of an object for a SDLGraphicsProgram
-	SDLGraphicsProgram mySDLGraphicsProgram(1280, 720);
+	SDLGraphicsProgram mySDLGraphicsProgram(1280, 720, world, display);
+	if (runBenchmark) {
+		mySDLGraphicsProgram.SetBenchmark(input, report);
+	}
+	if (!record.empty()) {
+		mySDLGraphicsProgram.SetRecording(record);
+	}
 	// Run our program forever
 	mySDLGraphicsProgram.Loop();
 	// When our program ends, it will exit scope, the